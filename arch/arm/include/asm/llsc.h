@@ -0,0 +1,75 @@
+#ifndef __ASM_ARM_LLSC_H
+#define __ASM_ARM_LLSC_H
+
+/*
+ * Singly linked freelists updated with ldrex/strex, for the SLUB fastpaths.
+ *
+ * The exception return path clears the exclusive monitor (see svc_exit),
+ * so the strex fails whenever an interrupt came in after the ldrex: the
+ * update is atomic with respect to everything else running on this cpu,
+ * without disabling interrupts, and with no ABA problem since no other
+ * code can touch the list in between.  The caller must keep preemption
+ * disabled, the list head is that of the local cpu.
+ *
+ * Nothing but loads, and the store of the new object's link, happen
+ * between the ldrex and the strex.
+ */
+#if __LINUX_ARM_ARCH__ >= 6
+
+#define ARCH_HAVE_LLSC_FREELIST
+
+/*
+ * Unlink and return the first object of the list at @head, the link of an
+ * object being the word at @offset in it.  Returns NULL if it is empty.
+ */
+static inline void *llsc_freelist_pop(void **head, unsigned long offset)
+{
+	void *object, *next;
+	unsigned long fail;
+
+	__asm__ __volatile__("@ llsc_freelist_pop\n"
+"1:	ldrex	%0, [%3]\n"
+"	teq	%0, #0\n"
+"	beq	2f\n"
+"	ldr	%1, [%0, %4]\n"
+"	strex	%2, %1, [%3]\n"
+"	teq	%2, #0\n"
+"	bne	1b\n"
+"2:"
+	: "=&r" (object), "=&r" (next), "=&r" (fail)
+	: "r" (head), "r" (offset)
+	: "cc", "memory");
+
+	return object;
+}
+
+/*
+ * Link @object in at the head of the list at @head, but only as long as
+ * *@owner is @page.  Returns 0 if it is not.
+ */
+static inline int llsc_freelist_push(void **head, void *owner, void *page,
+				     void *object, unsigned long offset)
+{
+	void *first, *cur;
+	unsigned long fail;
+
+	__asm__ __volatile__("@ llsc_freelist_push\n"
+"1:	ldrex	%0, [%3]\n"
+"	ldr	%1, [%4]\n"
+"	teq	%1, %5\n"
+"	bne	2f\n"
+"	str	%0, [%6, %7]\n"
+"	strex	%2, %6, [%3]\n"
+"	teq	%2, #0\n"
+"	bne	1b\n"
+"2:"
+	: "=&r" (first), "=&r" (cur), "=&r" (fail)
+	: "r" (head), "r" (owner), "r" (page), "r" (object), "r" (offset)
+	: "cc", "memory");
+
+	return cur == page;
+}
+
+#endif /* __LINUX_ARM_ARCH__ >= 6 */
+
+#endif /* __ASM_ARM_LLSC_H */
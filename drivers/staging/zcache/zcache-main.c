@@ -27,6 +27,7 @@
 #include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/atomic.h>
+#include <linux/workqueue.h>
 #include "tmem.h"
 
 #include "../zram/xvmalloc.h" /* if built in drivers/staging */
@@ -373,7 +374,7 @@ static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 	struct zbud_page *zbpg;
 	unsigned budnum = zbud_budnum(zh);
 	size_t out_len = PAGE_SIZE;
-	char *to_va, *from_va;
+	unsigned char *to_va, *from_va;
 	unsigned size;
 	int ret = 0;
 
@@ -388,7 +389,7 @@ static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 	BUG_ON(zh->size == 0 || zh->size > zbud_max_buddy_size());
 	to_va = kmap_atomic(page, KM_USER0);
 	size = zh->size;
-	from_va = zbud_data(zh, size);
+	from_va = (unsigned char *)zbud_data(zh, size);
 	ret = lzo1x_decompress_safe(from_va, size, to_va, &out_len);
 	BUG_ON(ret != LZO_E_OK);
 	BUG_ON(out_len != PAGE_SIZE);
@@ -599,17 +600,30 @@ struct zv_hdr {
 	uint32_t pool_id;
 	struct tmem_oid oid;
 	uint32_t index;
+	struct list_head lru;
 	DECL_SENTINEL
 };
 
 static const int zv_max_page_size = (PAGE_SIZE / 8) * 7;
 
+/*
+ * All zv pages in put order, oldest first, so that the coldest ones can be
+ * written back to the real swap device when the pool is full.
+ *
+ * zv_lru_lock is always taken with interrupts disabled.  zv_create() and
+ * zv_free() run inside tmem operations, which have them off already; the
+ * writeback worker runs in process context and saves them itself.
+ */
+static LIST_HEAD(zv_lru_list);
+static DEFINE_SPINLOCK(zv_lru_lock);
+
 static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
 				struct tmem_oid *oid, uint32_t index,
 				void *cdata, unsigned clen)
 {
 	struct page *page;
 	struct zv_hdr *zv = NULL;
+	unsigned long flags;
 	uint32_t offset;
 	int ret;
 
@@ -625,6 +639,9 @@ static struct zv_hdr *zv_create(struct xv_pool *xvpool, uint32_t pool_id,
 	SET_SENTINEL(zv, ZVH);
 	memcpy((char *)zv + sizeof(struct zv_hdr), cdata, clen);
 	kunmap_atomic(zv, KM_USER0);
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	list_add_tail(&zv->lru, &zv_lru_list);
+	spin_unlock_irqrestore(&zv_lru_lock, flags);
 out:
 	return zv;
 }
@@ -642,7 +659,9 @@ static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
 	INVERT_SENTINEL(zv, ZVH);
 	page = virt_to_page(zv);
 	offset = (unsigned long)zv & ~PAGE_MASK;
-	local_irq_save(flags);
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	list_del(&zv->lru);
+	spin_unlock(&zv_lru_lock);
 	xv_free(xvpool, page, offset);
 	local_irq_restore(flags);
 }
@@ -650,7 +669,7 @@ static void zv_free(struct xv_pool *xvpool, struct zv_hdr *zv)
 static void zv_decompress(struct page *page, struct zv_hdr *zv)
 {
 	size_t clen = PAGE_SIZE;
-	char *to_va;
+	unsigned char *to_va;
 	unsigned size;
 	int ret;
 
@@ -658,7 +677,7 @@ static void zv_decompress(struct page *page, struct zv_hdr *zv)
 	size = xv_get_object_size(zv) - sizeof(*zv);
 	BUG_ON(size == 0 || size > zv_max_page_size);
 	to_va = kmap_atomic(page, KM_USER0);
-	ret = lzo1x_decompress_safe((char *)zv + sizeof(*zv),
+	ret = lzo1x_decompress_safe((unsigned char *)zv + sizeof(*zv),
 					size, to_va, &clen);
 	kunmap_atomic(to_va, KM_USER0);
 	BUG_ON(ret != LZO_E_OK);
@@ -676,6 +695,8 @@ static unsigned long zcache_flobj_total;
 static unsigned long zcache_flobj_found;
 static unsigned long zcache_failed_eph_puts;
 static unsigned long zcache_failed_pers_puts;
+static unsigned long zcache_frontswap_writebacks;
+static unsigned long zcache_frontswap_failed_writebacks;
 
 #define MAX_POOLS_PER_CLIENT 16
 
@@ -901,6 +922,15 @@ static unsigned long zcache_curr_pers_pampd_count_max;
 /* forward reference */
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len);
 
+/* # of zv pages written back to the swap device per round */
+#define ZCACHE_WRITEBACK_BATCH	32
+
+#ifdef CONFIG_FRONTSWAP
+static void zcache_frontswap_writeback_kick(void);
+#else
+static inline void zcache_frontswap_writeback_kick(void) { }
+#endif
+
 static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 				 uint32_t index, struct page *page)
 {
@@ -928,12 +958,15 @@ static void *zcache_pampd_create(struct tmem_pool *pool, struct tmem_oid *oid,
 		}
 	} else {
 		/*
-		 * FIXME: This is all the "policy" there is for now.
 		 * 3/4 totpages should allow ~37% of RAM to be filled with
-		 * compressed frontswap pages
+		 * compressed frontswap pages.  Start writing the oldest ones
+		 * back to the swap device a batch before the pool is full,
+		 * so that new (hot) pages keep being accepted.
 		 */
-		if (atomic_read(&zcache_curr_pers_pampd_count) >
-							3 * totalram_pages / 4)
+		count = atomic_read(&zcache_curr_pers_pampd_count);
+		if (count + ZCACHE_WRITEBACK_BATCH > 3 * totalram_pages / 4)
+			zcache_frontswap_writeback_kick();
+		if (count > 3 * totalram_pages / 4)
 			goto out;
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
@@ -1007,7 +1040,7 @@ static int zcache_compress(struct page *from, void **out_va, size_t *out_len)
 	int ret = 0;
 	unsigned char *dmem = __get_cpu_var(zcache_dstmem);
 	unsigned char *wmem = __get_cpu_var(zcache_workmem);
-	char *from_va;
+	unsigned char *from_va;
 
 	BUG_ON(!irqs_disabled());
 	if (unlikely(dmem == NULL || wmem == NULL))
@@ -1122,6 +1155,8 @@ ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(aborted_preload);
 ZCACHE_SYSFS_RO(aborted_shrink);
 ZCACHE_SYSFS_RO(compress_poor);
+ZCACHE_SYSFS_RO(frontswap_writebacks);
+ZCACHE_SYSFS_RO(frontswap_failed_writebacks);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1143,6 +1178,8 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_eph_puts_attr.attr,
 	&zcache_failed_pers_puts_attr.attr,
 	&zcache_compress_poor_attr.attr,
+	&zcache_frontswap_writebacks_attr.attr,
+	&zcache_frontswap_failed_writebacks_attr.attr,
 	&zcache_zbud_curr_raw_pages_attr.attr,
 	&zcache_zbud_curr_zpages_attr.attr,
 	&zcache_zbud_curr_zbytes_attr.attr,
@@ -1531,6 +1568,51 @@ static void zcache_frontswap_flush_area(unsigned type)
 	}
 }
 
+/*
+ * Write the oldest frontswap pages back to the swap device in batches.
+ * Entries are rotated to the tail as they are picked so that pages which
+ * cannot be written back right now are not retried immediately.
+ */
+static void zcache_frontswap_writeback_fn(struct work_struct *work)
+{
+	struct {
+		unsigned type;
+		pgoff_t offset;
+	} batch[ZCACHE_WRITEBACK_BATCH];
+	struct zv_hdr *zv;
+	unsigned long flags;
+	int i, nr = 0;
+
+	spin_lock_irqsave(&zv_lru_lock, flags);
+	while (nr < ZCACHE_WRITEBACK_BATCH && !list_empty(&zv_lru_list)) {
+		zv = list_first_entry(&zv_lru_list, struct zv_hdr, lru);
+		if (zv->pool_id == zcache_frontswap_poolid) {
+			batch[nr].type = zv->oid.oid[0] >> SWIZ_BITS;
+			batch[nr].offset = (zv->index << SWIZ_BITS) |
+					(zv->oid.oid[0] & SWIZ_MASK);
+			nr++;
+		}
+		list_move_tail(&zv->lru, &zv_lru_list);
+	}
+	spin_unlock_irqrestore(&zv_lru_lock, flags);
+
+	for (i = 0; i < nr; i++) {
+		if (frontswap_writeback_page(batch[i].type,
+						batch[i].offset) == 0)
+			zcache_frontswap_writebacks++;
+		else
+			zcache_frontswap_failed_writebacks++;
+	}
+}
+
+static DECLARE_WORK(zcache_frontswap_writeback_work,
+			zcache_frontswap_writeback_fn);
+
+static void zcache_frontswap_writeback_kick(void)
+{
+	schedule_work(&zcache_frontswap_writeback_work);
+}
+
 static void zcache_frontswap_init(unsigned ignored)
 {
 	/* a single tmem poolid is used for all frontswap "types" (swapfiles) */
@@ -1048,6 +1048,10 @@ static int ncm_unwrap_ntb(struct gether *port,
 			     dg_len);
 			goto err;
 		}
+		if (index > skb->len || dg_len > skb->len - index) {
+			ret = -EOVERFLOW;
+			goto err;
+		}
 		if (ncm->is_crc) {
 			uint32_t crc, crc2;
 
@@ -1065,20 +1069,23 @@ static int ncm_unwrap_ntb(struct gether *port,
 		index2 = get_ncm(&tmp, opts->dgram_item_len);
 		dg_len2 = get_ncm(&tmp, opts->dgram_item_len);
 
+		/*
+		 * Every datagram but the last is copied out: clones would
+		 * share one skb_shinfo, which GRO writes into.
+		 */
 		if (index2 == 0 || dg_len2 == 0) {
 			skb2 = skb;
+			skb_pull(skb2, index);
+			skb_trim(skb2, dg_len - crc_len);
 		} else {
-			skb2 = skb_clone(skb, GFP_ATOMIC);
+			skb2 = alloc_skb(dg_len - crc_len + NET_IP_ALIGN,
+					 GFP_ATOMIC);
 			if (skb2 == NULL)
 				goto err;
+			skb_reserve(skb2, NET_IP_ALIGN);
+			memcpy(skb_put(skb2, dg_len - crc_len),
+			       skb->data + index, dg_len - crc_len);
 		}
-
-		if (!skb_pull(skb2, index)) {
-			ret = -EOVERFLOW;
-			goto err;
-		}
-
-		skb_trim(skb2, dg_len - crc_len);
 		skb_queue_tail(list, skb2);
 
 		ndp_len -= 2 * (opts->dgram_item_len * 2);
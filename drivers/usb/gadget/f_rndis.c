@@ -76,6 +76,14 @@
  *   - MS-Windows drivers sometimes emit undocumented requests.
  */
 
+/* Let the host batch this many packets in each OUT transfer; the
+ * RNDIS framing is then split again in rndis_rm_hdr().
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"Maximum packets per transfer for UL aggregation");
+
 struct rndis_ep_descs {
 	struct usb_endpoint_descriptor	*in;
 	struct usb_endpoint_descriptor	*out;
@@ -708,6 +716,11 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
+	rndis->port.ul_max_pkts_per_xfer =
+		clamp(rndis_ul_max_pkt_per_xfer, 1U, 16U);
+	rndis_set_max_pkt_xfer(rndis->config,
+			       rndis->port.ul_max_pkts_per_xfer);
+
 	if (rndis_set_param_vendor(rndis->config, rndis->vendorID,
 				   rndis->manufacturer))
 			goto fail;
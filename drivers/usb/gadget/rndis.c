@@ -569,6 +569,7 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	rndis_init_cmplt_type *resp;
 	rndis_resp_t *r;
 	struct rndis_params *params = rndis_per_dev_params + configNr;
+	u32 max_pkts = params->max_pkt_per_xfer ? : 1;
 
 	if (!params->dev)
 		return -ENOTSUPP;
@@ -586,13 +587,16 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
+	resp->MaxPacketsPerTransfer = cpu_to_le32(max_pkts);
 	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
-		+ sizeof(struct ethhdr)
-		+ sizeof(struct rndis_packet_msg_type)
+		  max_pkts * (params->dev->mtu
+			+ sizeof(struct ethhdr)
+			+ sizeof(struct rndis_packet_msg_type))
 		+ 22);
-	resp->PacketAlignmentFactor = cpu_to_le32(0);
+	/* With several packets per transfer, have the host start each one
+	 * on a 4 byte boundary so that their IP headers stay aligned.
+	 */
+	resp->PacketAlignmentFactor = cpu_to_le32(max_pkts > 1 ? 2 : 0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
 
@@ -791,6 +795,13 @@ void rndis_set_host_mac(int configNr, const u8 *addr)
 	rndis_per_dev_params[configNr].host_mac = addr;
 }
 
+void rndis_set_max_pkt_xfer(u8 configNr, u8 max_pkt_per_xfer)
+{
+	pr_debug("%s:\n", __func__);
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer = max_pkt_per_xfer;
+}
+
 /*
  * Message Parser
  */
@@ -1024,28 +1035,64 @@ static rndis_resp_t *rndis_add_response(int configNr, u32 length)
 	return r;
 }
 
+/*
+ * One OUT transfer may carry up to MaxPacketsPerTransfer packet messages
+ * back to back.  All but the last are copied into skbs of their own,
+ * since clones would share the skb_shinfo that GRO writes into; whatever
+ * follows the last complete message is padding, which RNDIS allows up to
+ * the end of the transfer.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	struct rndis_packet_msg_type *hdr;
+	struct sk_buff *skb2;
+	u32 msg_len, data_offset, data_len;
+
+	for (;;) {
+		hdr = (void *)skb->data;
+
+		/* MessageType, MessageLength */
+		if (skb->len < sizeof(*hdr) ||
+		    cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(&hdr->MessageType)) {
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(&hdr->MessageLength);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(&hdr->DataOffset) + 8;
+		data_len = get_unaligned_le32(&hdr->DataLength);
+		if (data_offset > skb->len) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* anything but another packet message ends the transfer */
+		if (msg_len < data_offset + data_len ||
+		    msg_len > skb->len ||
+		    skb->len - msg_len < sizeof(*hdr) ||
+		    cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned((__le32 *)(skb->data + msg_len)))
+			break;
+
+		skb2 = alloc_skb(data_len + NET_IP_ALIGN, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_reserve(skb2, NET_IP_ALIGN);
+		memcpy(skb_put(skb2, data_len), skb->data + data_offset,
+		       data_len);
+		skb_queue_tail(list, skb2);
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
+	skb_pull(skb, data_offset);
+	skb_trim(skb, data_len);
 	skb_queue_tail(list, skb);
 	return 0;
 }
@@ -235,6 +235,7 @@ typedef struct rndis_params
 	struct net_device	*dev;
 
 	u32			vendorID;
+	u8			max_pkt_per_xfer;
 	const char		*vendorDescr;
 	void			(*resp_avail)(void *v);
 	void			*v;
@@ -261,6 +262,7 @@ int  rndis_signal_connect (int configNr);
 int  rndis_signal_disconnect (int configNr);
 int  rndis_state (int configNr);
 extern void rndis_set_host_mac (int configNr, const u8 *addr);
+void rndis_set_max_pkt_xfer(u8 configNr, u8 max_pkt_per_xfer);
 
 int rndis_init(void);
 void rndis_exit (void);
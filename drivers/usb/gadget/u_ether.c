@@ -70,6 +70,7 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -92,6 +93,8 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define UETH_NAPI_WEIGHT	64
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -237,6 +240,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -275,58 +280,54 @@ enomem:
 	return retval;
 }
 
+/* Frames are only queued here; they reach the network stack from
+ * eth_poll(), which lets GRO merge the segments of a transfer.  Unwrapping
+ * goes through a private list: the framing code may purge that list on
+ * error, and frames of earlier transfers may still sit in rx_frames.
+ */
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context, *skb2;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
+	struct sk_buff_head frames;
+	unsigned long	flags;
 
 	switch (status) {
 
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		skb_queue_head_init(&frames);
 
 		if (dev->unwrap) {
-			unsigned long	flags;
-
 			spin_lock_irqsave(&dev->lock, flags);
 			if (dev->port_usb) {
 				status = dev->unwrap(dev->port_usb,
 							skb,
-							&dev->rx_frames);
+							&frames);
 			} else {
 				dev_kfree_skb_any(skb);
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
 		} else {
-			skb_queue_tail(&dev->rx_frames, skb);
+			skb_queue_tail(&frames, skb);
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
+		if (status < 0) {
+			dev->net->stats.rx_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
+			while ((skb2 = __skb_dequeue(&frames)) != NULL)
 				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+			break;
 		}
+
+		spin_lock_irqsave(&dev->rx_frames.lock, flags);
+		skb_queue_splice_tail_init(&frames, &dev->rx_frames);
+		spin_unlock_irqrestore(&dev->rx_frames.lock, flags);
+		napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -367,6 +368,43 @@ clean:
 		rx_submit(dev, req, GFP_ATOMIC);
 }
 
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work_done = 0;
+
+	while (work_done < budget &&
+			(skb = skb_dequeue(&dev->rx_frames)) != NULL) {
+		work_done++;
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		napi_gro_receive(napi, skb);
+	}
+
+	if (work_done < budget) {
+		napi_complete(napi);
+		/* rx_complete() may have queued frames after the last
+		 * dequeue, while its napi_schedule() was still a no-op.
+		 */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+	return work_done;
+}
+
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
 {
 	unsigned		i;
@@ -481,6 +519,8 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	/* byte queue limits completions must be serialized */
+	netdev_completed_queue(dev->net, 1, skb->len);
 	spin_unlock(&dev->req_lock);
 	dev_kfree_skb_any(skb);
 
@@ -499,6 +539,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 {
 	struct eth_dev		*dev = netdev_priv(net);
 	int			length = skb->len;
+	unsigned int		bql_bytes = 0;
 	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
@@ -604,6 +645,10 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 			? ((atomic_read(&dev->tx_qlen) % qmult) != 0)
 			: 0;
 
+	/* the request may complete before usb_ep_queue() returns */
+	bql_bytes = skb->len;
+	netdev_sent_queue(net, bql_bytes);
+
 	retval = usb_ep_queue(in, req, GFP_ATOMIC);
 	switch (retval) {
 	default:
@@ -622,6 +667,7 @@ drop:
 		if (list_empty(&dev->tx_reqs))
 			netif_start_queue(net);
 		list_add(&req->list, &dev->tx_reqs);
+		netdev_completed_queue(net, 1, bql_bytes);
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 	}
 	return NETDEV_TX_OK;
@@ -638,6 +684,7 @@ static void eth_start(struct eth_dev *dev, gfp_t gfp_flags)
 
 	/* and open the tx floodgates */
 	atomic_set(&dev->tx_qlen, 0);
+	netdev_reset_queue(dev->net);
 	netif_wake_queue(dev->net);
 }
 
@@ -647,6 +694,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -666,6 +714,7 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -699,6 +748,8 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -820,6 +871,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 		memcpy(ethaddr, dev->host_mac, ETH_ALEN);
 
 	net->netdev_ops = &eth_netdev_ops;
+	netif_napi_add(net, &dev->napi, eth_poll, UETH_NAPI_WEIGHT);
 
 	SET_ETHTOOL_OPS(net, &ops);
 
@@ -66,6 +66,8 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	/* OUT transfers may carry up to this many frames; 0 means one */
+	u32				ul_max_pkts_per_xfer;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
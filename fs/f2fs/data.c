@@ -763,6 +763,12 @@ int do_write_data_page(struct page *page, struct f2fs_io_info *fio)
 
 	set_page_writeback(page);
 
+	if (!is_cold_data(page)) {
+		stat_inc_user_data_blocks(F2FS_SB(inode->i_sb));
+		if (old_blkaddr != NEW_ADDR && S_ISREG(inode->i_mode))
+			set_inode_flag(F2FS_I(inode), FI_DATA_OVERWRITTEN);
+	}
+
 	/*
 	 * If current allocation needs SSR,
 	 * it had better in-place writes for updated data.
@@ -887,6 +893,12 @@ static int f2fs_write_data_pages(struct address_space *mapping,
 
 	f2fs_submit_merged_bio(sbi, DATA, WRITE);
 
+	/* One update per writeback of the file, however many blocks */
+	if (is_inode_flag_set(F2FS_I(inode), FI_DATA_OVERWRITTEN)) {
+		clear_inode_flag(F2FS_I(inode), FI_DATA_OVERWRITTEN);
+		f2fs_update_hotness(inode);
+	}
+
 	remove_dirty_dir_inode(inode);
 
 	wbc->nr_to_write = max((long)0, wbc->nr_to_write - diff);
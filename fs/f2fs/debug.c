@@ -17,6 +17,7 @@
 #include <linux/blkdev.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -58,6 +59,13 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->sits = SIT_I(sbi)->dirty_sentries;
 	si->fnids = NM_I(sbi)->fcnt;
 	si->bg_gc = sbi->bg_gc;
+	si->nr_issue = SM_I(sbi)->nr_issue;
+	si->urgent_gc = sbi->urgent_gc;
+	for (i = 0; i < 2; i++) {
+		si->victim_search[i] = sbi->victim_search[i];
+		si->victim_scanned[i] = sbi->victim_scanned[i];
+	}
+	si->bg_victim_hit = sbi->bg_victim_hit;
 	si->util_free = (int)(free_user_blocks(sbi) >> sbi->log_blocks_per_seg)
 		* 100 / (int)(sbi->user_block_count >> sbi->log_blocks_per_seg)
 		/ 2;
@@ -77,6 +85,11 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 		si->segment_count[i] = sbi->segment_count[i];
 		si->block_count[i] = sbi->block_count[i];
 	}
+
+	for (i = 0; i < NR_CURSEG_TYPE; i++)
+		si->log_block_count[i] = sbi->log_block_count[i];
+	si->user_data_blocks = sbi->user_data_blocks;
+	si->inplace_blocks = sbi->inplace_blocks;
 }
 
 /*
@@ -234,8 +247,14 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "  - Prefree: %d\n  - Free: %d (%d)\n\n",
 			   si->prefree_count, si->free_segs, si->free_secs);
 		seq_printf(s, "CP calls: %d\n", si->cp_count);
-		seq_printf(s, "GC calls: %d (BG: %d)\n",
-			   si->call_count, si->bg_gc);
+		seq_printf(s, "Queued discard: %u blocks\n", si->nr_issue);
+		seq_printf(s, "GC calls: %d (BG: %d, urgent: %d)\n",
+			   si->call_count, si->bg_gc, si->urgent_gc);
+		seq_printf(s, "Victim search: BG: %u (%llu segs), "
+			   "FG: %u (%llu segs), FG reused BG victim: %u\n",
+			   si->victim_search[BG_GC], si->victim_scanned[BG_GC],
+			   si->victim_search[FG_GC], si->victim_scanned[FG_GC],
+			   si->bg_victim_hit);
 		seq_printf(s, "  - data segments : %d\n", si->data_segs);
 		seq_printf(s, "  - node segments : %d\n", si->node_segs);
 		seq_printf(s, "Try to move %d blocks\n", si->tot_blks);
@@ -273,6 +292,30 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->block_count[SSR], si->segment_count[SSR]);
 		seq_printf(s, "LFS: %u blocks in %u segments\n",
 			   si->block_count[LFS], si->segment_count[LFS]);
+		seq_printf(s, "IPU: %llu blocks\n", si->inplace_blocks);
+
+		/* per-log allocation and write amplification */
+		seq_printf(s, "\nLog blocks: hot data: %llu, warm data: %llu, "
+			   "cold data: %llu\n",
+			   si->log_block_count[CURSEG_HOT_DATA],
+			   si->log_block_count[CURSEG_WARM_DATA],
+			   si->log_block_count[CURSEG_COLD_DATA]);
+		seq_printf(s, "            hot node: %llu, warm node: %llu, "
+			   "cold node: %llu\n",
+			   si->log_block_count[CURSEG_HOT_NODE],
+			   si->log_block_count[CURSEG_WARM_NODE],
+			   si->log_block_count[CURSEG_COLD_NODE]);
+		if (si->user_data_blocks) {
+			unsigned long long written = si->inplace_blocks;
+			unsigned int wa;
+
+			for (j = 0; j < NR_CURSEG_TYPE; j++)
+				written += si->log_block_count[j];
+			wa = div64_u64(written * 100, si->user_data_blocks);
+			seq_printf(s, "WA: %u.%02u (%llu / %llu user blocks)\n",
+				   wa / 100, wa % 100, written,
+				   si->user_data_blocks);
+		}
 
 		/* segment usage info */
 		update_sit_info(si->sbi);
@@ -196,6 +196,7 @@ struct extent_info {
  */
 #define FADVISE_COLD_BIT	0x01
 #define FADVISE_LOST_PINO_BIT	0x02
+#define FADVISE_HOT_BIT		0x20
 
 #define DEF_DIR_LEVEL		0
 
@@ -217,6 +218,10 @@ struct f2fs_inode_info {
 	nid_t i_xattr_nid;		/* node id that contains xattrs */
 	unsigned long long xattr_ver;	/* cp version of xattr modification */
 	struct extent_info ext;		/* in-memory extent cache entry */
+
+	/* data update frequency, see f2fs_update_hotness() */
+	unsigned int i_update_count;	/* # of overwrites in this interval */
+	unsigned long i_update_stamp;	/* start of the interval in jiffies */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -307,7 +312,7 @@ static inline void set_new_dnode(struct dnode_of_data *dn, struct inode *inode,
 #define NR_CURSEG_TYPE	(NR_CURSEG_DATA_TYPE + NR_CURSEG_NODE_TYPE)
 
 enum {
-	CURSEG_HOT_DATA	= 0,	/* directory entry blocks */
+	CURSEG_HOT_DATA	= 0,	/* directory entry and frequently updated blocks */
 	CURSEG_WARM_DATA,	/* data blocks */
 	CURSEG_COLD_DATA,	/* multimedia or GCed data blocks */
 	CURSEG_HOT_NODE,	/* direct node blocks of directory files */
@@ -342,8 +347,26 @@ struct f2fs_sm_info {
 	int nr_discards;			/* # of discards in the list */
 	int max_discards;			/* max. discards to be issued */
 
+	/* for asynchronous discard */
+	struct task_struct *discard_task;	/* discard issuing thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting for the thread */
+	wait_queue_head_t discard_done_wq;	/* waiting for an issued one */
+	spinlock_t issue_lock;			/* for issue_list/issuing_* */
+	struct mutex issue_mutex;		/* serializes issuers */
+	struct list_head issue_list;		/* sorted, merged extents */
+	unsigned int nr_issue;			/* # of blocks in issue_list */
+	block_t issuing_blkaddr;		/* extent under discard now */
+	unsigned int issuing_len;
+	bool discard_urgent;			/* FITRIM: no pause in rounds */
+	unsigned int discard_batch;		/* max. blocks per round */
+	unsigned int discard_interval;		/* msecs between rounds */
+
 	unsigned int ipu_policy;	/* in-place-update policy */
 	unsigned int min_ipu_util;	/* in-place-update threshold */
+
+	/* for hot data identification by update frequency */
+	unsigned int hot_update_thresh;		/* # of updates to be hot */
+	unsigned int hot_update_interval;	/* interval in msec */
 };
 
 /*
@@ -479,9 +502,16 @@ struct f2fs_sb_info {
 	struct f2fs_stat_info *stat_info;	/* FS status information */
 	unsigned int segment_count[2];		/* # of allocated segments */
 	unsigned int block_count[2];		/* # of allocated blocks */
+	unsigned long long log_block_count[NR_CURSEG_TYPE]; /* per log */
+	unsigned long long user_data_blocks;	/* data blocks written by user */
+	unsigned long long inplace_blocks;	/* in-place updated blocks */
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
 	int inline_inode;			/* # of inline_data inodes */
 	int bg_gc;				/* background gc calls */
+	int urgent_gc;				/* urgent background gc calls */
+	unsigned int victim_search[2];		/* # of victim searches */
+	unsigned long long victim_scanned[2];	/* # of segments scanned */
+	unsigned int bg_victim_hit;		/* FG GC reused a BG victim */
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
 #endif
 	unsigned int last_victim[2];		/* last victim segment # */
@@ -951,6 +981,8 @@ enum {
 	FI_NO_EXTENT,		/* not to use the extent cache */
 	FI_INLINE_XATTR,	/* used for inline xattr */
 	FI_INLINE_DATA,		/* used for inline data*/
+	FI_HOT_DATA,		/* data is updated frequently */
+	FI_DATA_OVERWRITTEN,	/* data overwritten since the last writeback */
 };
 
 static inline void set_inode_flag(struct f2fs_inode_info *fi, int flag)
@@ -1159,6 +1191,8 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
 void clear_prefree_segments(struct f2fs_sb_info *);
+int f2fs_trim_fs(struct f2fs_sb_info *, struct fstrim_range *);
+int start_discard_thread(struct f2fs_sb_info *);
 int npages_for_summary_flush(struct f2fs_sb_info *);
 void allocate_new_segments(struct f2fs_sb_info *);
 struct page *get_sum_page(struct f2fs_sb_info *, unsigned int);
@@ -1168,6 +1202,7 @@ void write_node_page(struct f2fs_sb_info *, struct page *,
 void write_data_page(struct page *, struct dnode_of_data *, block_t *,
 					struct f2fs_io_info *);
 void rewrite_data_page(struct page *, block_t, struct f2fs_io_info *);
+void f2fs_update_hotness(struct inode *);
 void recover_data_page(struct f2fs_sb_info *, struct page *,
 				struct f2fs_summary *, block_t, block_t);
 void rewrite_node_page(struct f2fs_sb_info *, struct page *,
@@ -1254,7 +1289,10 @@ struct f2fs_stat_info {
 	int ndirty_node, ndirty_dent, ndirty_dirs, ndirty_meta;
 	int nats, sits, fnids;
 	int total_count, utilization;
-	int bg_gc, inline_inode;
+	int bg_gc, urgent_gc, inline_inode;
+	unsigned int nr_issue;
+	unsigned int victim_search[2], bg_victim_hit;
+	unsigned long long victim_scanned[2];
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
@@ -1269,6 +1307,8 @@ struct f2fs_stat_info {
 
 	unsigned int segment_count[2];
 	unsigned int block_count[2];
+	unsigned long long log_block_count[NR_CURSEG_TYPE];
+	unsigned long long user_data_blocks, inplace_blocks;
 	unsigned base_mem, cache_mem;
 };
 
@@ -1280,6 +1320,13 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_cp_count(si)		((si)->cp_count++)
 #define stat_inc_call_count(si)		((si)->call_count++)
 #define stat_inc_bggc_count(sbi)	((sbi)->bg_gc++)
+#define stat_inc_urgent_gc_count(sbi)	((sbi)->urgent_gc++)
+#define stat_inc_victim_search(sbi, gc_type, nscanned)			\
+	do {								\
+		(sbi)->victim_search[gc_type]++;			\
+		(sbi)->victim_scanned[gc_type] += (nscanned);		\
+	} while (0)
+#define stat_inc_bg_victim_hit(sbi)	((sbi)->bg_victim_hit++)
 #define stat_inc_dirty_dir(sbi)		((sbi)->n_dirty_dirs++)
 #define stat_dec_dirty_dir(sbi)		((sbi)->n_dirty_dirs--)
 #define stat_inc_total_hit(sb)		((F2FS_SB(sb))->total_hit_ext++)
@@ -1299,6 +1346,10 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		((sbi)->segment_count[(curseg)->alloc_type]++)
 #define stat_inc_block_count(sbi, curseg)				\
 		((sbi)->block_count[(curseg)->alloc_type]++)
+#define stat_inc_log_block_count(sbi, type)				\
+		((sbi)->log_block_count[type]++)
+#define stat_inc_user_data_blocks(sbi)	((sbi)->user_data_blocks++)
+#define stat_inc_inplace_blocks(sbi)	((sbi)->inplace_blocks++)
 
 #define stat_inc_seg_count(sbi, type)					\
 	do {								\
@@ -1335,6 +1386,9 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_cp_count(si)
 #define stat_inc_call_count(si)
 #define stat_inc_bggc_count(si)
+#define stat_inc_urgent_gc_count(sbi)
+#define stat_inc_victim_search(sbi, gc_type, nscanned)
+#define stat_inc_bg_victim_hit(sbi)
 #define stat_inc_dirty_dir(sbi)
 #define stat_dec_dirty_dir(sbi)
 #define stat_inc_total_hit(sb)
@@ -1343,6 +1397,9 @@ void f2fs_destroy_root_stats(void);
 #define stat_dec_inline_inode(inode)
 #define stat_inc_seg_type(sbi, curseg)
 #define stat_inc_block_count(sbi, curseg)
+#define stat_inc_log_block_count(sbi, type)
+#define stat_inc_user_data_blocks(sbi)
+#define stat_inc_inplace_blocks(sbi)
 #define stat_inc_seg_count(si, type)
 #define stat_inc_tot_blk_count(si, blks)
 #define stat_inc_data_blk_count(si, blks)
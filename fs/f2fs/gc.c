@@ -40,18 +40,36 @@ static int gc_thread_func(void *data)
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_th->gc_wake,
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
 
+		gc_th->gc_wake = false;
+
+		/*
+		 * Free space is running out: clean right away instead of
+		 * waiting for an idle window, so that f2fs_balance_fs() does
+		 * not have to fall back to foreground GC.
+		 */
+		if (gc_th->gc_urgent && !need_urgent_gc(sbi))
+			gc_th->gc_urgent = false;
+
+		if (gc_th->gc_urgent) {
+			wait_ms = gc_th->urgent_sleep_time;
+			mutex_lock(&sbi->gc_mutex);
+			stat_inc_urgent_gc_count(sbi);
+			goto do_gc;
+		}
+
 		/*
 		 * [GC triggering condition]
 		 * 0. GC is not conducted currently.
 		 * 1. There are enough dirty segments.
-		 * 2. IO subsystem is idle by checking the # of writeback pages.
-		 * 3. IO subsystem is idle by checking the # of requests in
-		 *    bdev's request list.
+		 * 2. IO subsystem is idle by checking the # of requests in
+		 *    bdev's request list and the disk's in-flight counters.
+		 * 3. No request has completed for gc_idle_interval.
 		 *
 		 * Note) We have to avoid triggering GCs too much frequently.
 		 * Because it is possible that some segments can be
@@ -62,7 +80,11 @@ static int gc_thread_func(void *data)
 			continue;
 
 		if (!is_idle(sbi)) {
-			wait_ms = increase_sleep_time(gc_th, wait_ms);
+			/* GC is due, so look again shortly for a gap in I/O */
+			if (has_enough_invalid_blocks(sbi))
+				wait_ms = gc_th->idle_interval;
+			else
+				wait_ms = increase_sleep_time(gc_th, wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
 		}
@@ -71,12 +93,17 @@ static int gc_thread_func(void *data)
 			wait_ms = decrease_sleep_time(gc_th, wait_ms);
 		else
 			wait_ms = increase_sleep_time(gc_th, wait_ms);
-
+do_gc:
 		stat_inc_bggc_count(sbi);
 
-		/* if return value is not zero, no victim was selected */
+		/*
+		 * If return value is not zero, no victim was selected.
+		 * Stay in urgent mode so that f2fs_balance_fs() does not keep
+		 * waking us up for nothing, but back off until it is rechecked.
+		 */
 		if (f2fs_gc(sbi))
-			wait_ms = gc_th->no_gc_sleep_time;
+			wait_ms = gc_th->gc_urgent ? gc_th->max_sleep_time :
+						gc_th->no_gc_sleep_time;
 
 		/* balancing f2fs's metadata periodically */
 		f2fs_balance_fs_bg(sbi);
@@ -103,8 +130,17 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
 
+	gc_th->urgent_sleep_time = DEF_GC_THREAD_URGENT_SLEEP_TIME;
+
 	gc_th->gc_idle = 0;
 
+	gc_th->idle_interval = DEF_GC_IDLE_INTERVAL;
+	gc_th->last_busy = jiffies;
+	gc_th->last_ios = 0;
+
+	gc_th->urgent_free_secs = DEF_GC_URGENT_FREE_SECS;
+	gc_th->gc_urgent = false;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -132,6 +168,10 @@ static int select_gc_type(struct f2fs_gc_kthread *gc_th, int gc_type)
 {
 	int gc_mode = (gc_type == BG_GC) ? GC_CB : GC_GREEDY;
 
+	/* reclaim the most space per cleaned section when space is short */
+	if (gc_th && gc_th->gc_urgent)
+		return GC_GREEDY;
+
 	if (gc_th && gc_th->gc_idle) {
 		if (gc_th->gc_idle == 1)
 			gc_mode = GC_CB;
@@ -260,6 +300,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 	struct victim_sel_policy p;
 	unsigned int secno, max_cost;
 	int nsearched = 0;
+	unsigned int nscanned = 0;
 
 	p.alloc_mode = alloc_mode;
 	select_policy(sbi, gc_type, type, &p);
@@ -271,8 +312,10 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 
 	if (p.alloc_mode == LFS && gc_type == FG_GC) {
 		p.min_segno = check_bg_victims(sbi);
-		if (p.min_segno != NULL_SEGNO)
+		if (p.min_segno != NULL_SEGNO) {
+			stat_inc_bg_victim_hit(sbi);
 			goto got_it;
+		}
 	}
 
 	while (1) {
@@ -290,6 +333,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			break;
 		}
 
+		nscanned++;
 		p.offset = segno + p.ofs_unit;
 		if (p.ofs_unit > 1)
 			p.offset -= segno % p.ofs_unit;
@@ -315,6 +359,9 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			break;
 		}
 	}
+	if (p.alloc_mode == LFS)
+		stat_inc_victim_search(sbi, gc_type, nscanned);
+
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
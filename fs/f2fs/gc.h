@@ -16,6 +16,13 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_URGENT_SLEEP_TIME	500	/* 500 ms while space is low */
+#define DEF_GC_IDLE_INTERVAL		2000	/* no I/O for 2 sec = idle */
+#define DEF_GC_URGENT_FREE_SECS		8	/*
+						 * start urgent background GC
+						 * this many sections before
+						 * foreground GC kicks in
+						 */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -31,8 +38,20 @@ struct f2fs_gc_kthread {
 	unsigned int max_sleep_time;
 	unsigned int no_gc_sleep_time;
 
+	unsigned int urgent_sleep_time;
+
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/* for finding idle I/O windows */
+	unsigned int idle_interval;	/* msecs without I/O to be idle */
+	unsigned long last_busy;	/* jiffies when I/O was last seen */
+	unsigned long last_ios;		/* completed I/Os at last check */
+
+	/* for cleaning ahead of foreground GC */
+	unsigned int urgent_free_secs;
+	bool gc_urgent;			/* cleaning ahead of foreground GC */
+	bool gc_wake;			/* kicked by f2fs_balance_fs() */
 };
 
 struct inode_entry {
@@ -101,10 +120,41 @@ static inline bool has_enough_invalid_blocks(struct f2fs_sb_info *sbi)
 	return false;
 }
 
+static inline bool need_urgent_gc(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+	int node_secs = get_blocktype_secs(sbi, F2FS_DIRTY_NODES);
+	int dent_secs = get_blocktype_secs(sbi, F2FS_DIRTY_DENTS);
+
+	if (!gc_th || unlikely(sbi->por_doing))
+		return false;
+
+	return free_sections(sbi) <= node_secs + 2 * dent_secs +
+			reserved_sections(sbi) + gc_th->urgent_free_secs;
+}
+
+/*
+ * The device is idle when nothing is queued or in flight on the whole disk
+ * and no request has completed for at least idle_interval msecs, so that GC
+ * only runs in real gaps between user I/O bursts.
+ */
 static inline int is_idle(struct f2fs_sb_info *sbi)
 {
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	struct block_device *bdev = sbi->sb->s_bdev;
 	struct request_queue *q = bdev_get_queue(bdev);
 	struct request_list *rl = &q->rq;
-	return !(rl->count[BLK_RW_SYNC]) && !(rl->count[BLK_RW_ASYNC]);
+	struct hd_struct *part = &bdev->bd_disk->part0;
+	unsigned long ios;
+
+	ios = part_stat_read(part, ios[READ]) + part_stat_read(part, ios[WRITE]);
+	if (ios != gc_th->last_ios || part_in_flight(part) ||
+			rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC]) {
+		gc_th->last_ios = ios;
+		gc_th->last_busy = jiffies;
+		return 0;
+	}
+
+	return time_after(jiffies, gc_th->last_busy +
+				msecs_to_jiffies(gc_th->idle_interval));
 }
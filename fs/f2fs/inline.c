@@ -106,6 +106,7 @@ static int __f2fs_convert_inline_data(struct inode *inode, struct page *page)
 
 	/* write data page to try to make data consistent */
 	set_page_writeback(page);
+	stat_inc_user_data_blocks(sbi);
 	write_data_page(page, &dn, &new_blk_addr, &fio);
 	update_extent_cache(new_blk_addr, &dn);
 	f2fs_wait_on_page_writeback(page, DATA);
@@ -108,6 +108,28 @@ static inline void set_cold_files(struct f2fs_sb_info *sbi, struct inode *inode,
 	}
 }
 
+/*
+ * Database and journal files are overwritten in place over and over, so
+ * start them off in the hot data log instead of waiting for the update
+ * counter in f2fs_update_hotness() to catch up.
+ */
+static const char * const hot_extensions[] = {
+	"db", "db-journal", "db-wal", "db-shm", "journal",
+};
+
+static inline void set_hot_files(struct inode *inode,
+		const unsigned char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(hot_extensions); i++) {
+		if (is_multimedia_file(name, hot_extensions[i])) {
+			file_set_hot(inode);
+			break;
+		}
+	}
+}
+
 static int f2fs_create(struct inode *dir, struct dentry *dentry, int mode,
 						struct nameidata *nd)
 {
@@ -123,8 +145,11 @@ static int f2fs_create(struct inode *dir, struct dentry *dentry, int mode,
 	if (IS_ERR(inode))
 		return PTR_ERR(inode);
 
-	if (!test_opt(sbi, DISABLE_EXT_IDENTIFY))
+	if (!test_opt(sbi, DISABLE_EXT_IDENTIFY)) {
 		set_cold_files(sbi, inode, dentry->d_name.name);
+		if (!file_is_cold(inode))
+			set_hot_files(inode, dentry->d_name.name);
+	}
 
 	inode->i_op = &f2fs_file_inode_operations;
 	inode->i_fop = &f2fs_file_operations;
@@ -15,10 +15,13 @@
 #include <linux/prefetch.h>
 #include <linux/vmalloc.h>
 #include <linux/swap.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 #include "f2fs.h"
 #include "segment.h"
 #include "node.h"
+#include "gc.h"
 #include <trace/events/f2fs.h>
 
 #define __reverse_ffz(x) __reverse_ffs(~(x))
@@ -184,6 +187,17 @@ void f2fs_balance_fs(struct f2fs_sb_info *sbi)
 	if (has_not_enough_free_secs(sbi, 0)) {
 		mutex_lock(&sbi->gc_mutex);
 		f2fs_gc(sbi);
+		return;
+	}
+
+	/*
+	 * Getting close to that point: let the background GC thread start
+	 * cleaning now, so that the writer does not have to do it itself.
+	 */
+	if (need_urgent_gc(sbi) && !sbi->gc_thread->gc_urgent) {
+		sbi->gc_thread->gc_urgent = true;
+		sbi->gc_thread->gc_wake = true;
+		wake_up_interruptible_all(&sbi->gc_thread->gc_wait_queue_head);
 	}
 }
 
@@ -276,6 +290,291 @@ static void f2fs_issue_discard(struct f2fs_sb_info *sbi,
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
 }
 
+/*
+ * Discards are not sent from the checkpoint path. They are queued in
+ * issue_list, kept sorted by address with adjacent extents merged, and sent
+ * in rounds of at most discard_batch blocks by the discard thread, so that
+ * TRIM cost is taken out of checkpoint latency and spread over time.
+ *
+ * A queued extent can cover blocks that get reused once its segment is
+ * allocated again, so reset_curseg() drops the new segment from the queue
+ * and waits for any discard in flight over it before the segment is used.
+ * No single command is longer than discard_batch blocks, which bounds that
+ * wait.
+ */
+static void __insert_discard(struct f2fs_sm_info *sm_i, block_t blkstart,
+			block_t blklen, struct discard_entry **new)
+{
+	struct list_head *head = &sm_i->issue_list;
+	struct discard_entry *entry, *next, *prev = NULL;
+	block_t end = blkstart + blklen;
+
+	list_for_each_entry_reverse(entry, head, list) {
+		if (entry->blkaddr <= blkstart) {
+			prev = entry;
+			break;
+		}
+	}
+
+	if (prev && prev->blkaddr + prev->len >= blkstart) {
+		if (end > prev->blkaddr + prev->len) {
+			sm_i->nr_issue += end - (prev->blkaddr + prev->len);
+			prev->len = end - prev->blkaddr;
+		}
+		entry = prev;
+	} else {
+		entry = *new;
+		*new = NULL;
+		INIT_LIST_HEAD(&entry->list);
+		entry->blkaddr = blkstart;
+		entry->len = blklen;
+		list_add(&entry->list, prev ? &prev->list : head);
+		sm_i->nr_issue += blklen;
+	}
+
+	/* absorb the following extents that are now adjacent or overlapping */
+	while (entry->list.next != head) {
+		block_t cur_end = entry->blkaddr + entry->len;
+
+		next = list_entry(entry->list.next, struct discard_entry, list);
+		if (next->blkaddr > cur_end)
+			break;
+
+		if (next->blkaddr + next->len > cur_end) {
+			sm_i->nr_issue -= cur_end - next->blkaddr;
+			entry->len = next->blkaddr + next->len - entry->blkaddr;
+		} else {
+			sm_i->nr_issue -= next->len;
+		}
+		list_del(&next->list);
+		kmem_cache_free(discard_entry_slab, next);
+	}
+}
+
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	struct discard_entry *new;
+
+	new = f2fs_kmem_cache_alloc(discard_entry_slab, GFP_NOFS);
+
+	spin_lock(&sm_i->issue_lock);
+	__insert_discard(sm_i, blkstart, blklen, &new);
+	spin_unlock(&sm_i->issue_lock);
+
+	if (new)
+		kmem_cache_free(discard_entry_slab, new);
+}
+
+/*
+ * Remove [start, end) from the queued extents. Returns false if an extent
+ * has to be split and no spare entry was given for the second half.
+ */
+static bool __drop_discard(struct f2fs_sm_info *sm_i, block_t start,
+			block_t end, struct discard_entry **new)
+{
+	struct discard_entry *entry, *this;
+
+	list_for_each_entry_safe(entry, this, &sm_i->issue_list, list) {
+		block_t entry_end = entry->blkaddr + entry->len;
+
+		if (entry->blkaddr >= end)
+			break;
+		if (entry_end <= start)
+			continue;
+
+		if (entry->blkaddr < start && entry_end > end) {
+			if (!*new)
+				return false;
+			(*new)->blkaddr = end;
+			(*new)->len = entry_end - end;
+			list_add(&(*new)->list, &entry->list);
+			*new = NULL;
+			entry->len = start - entry->blkaddr;
+			sm_i->nr_issue -= end - start;
+			break;
+		}
+
+		if (entry->blkaddr < start) {
+			sm_i->nr_issue -= entry_end - start;
+			entry->len = start - entry->blkaddr;
+		} else if (entry_end > end) {
+			sm_i->nr_issue -= end - entry->blkaddr;
+			entry->len = entry_end - end;
+			entry->blkaddr = end;
+		} else {
+			sm_i->nr_issue -= entry->len;
+			list_del(&entry->list);
+			kmem_cache_free(discard_entry_slab, entry);
+		}
+	}
+	return true;
+}
+
+static bool discard_in_flight(struct f2fs_sm_info *sm_i,
+				block_t start, block_t end)
+{
+	bool ret;
+
+	spin_lock(&sm_i->issue_lock);
+	ret = sm_i->issuing_len && sm_i->issuing_blkaddr < end &&
+			sm_i->issuing_blkaddr + sm_i->issuing_len > start;
+	spin_unlock(&sm_i->issue_lock);
+	return ret;
+}
+
+static void f2fs_wait_discard(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	struct discard_entry *new = NULL;
+	block_t start = START_BLOCK(sbi, segno);
+	block_t end = start + sbi->blocks_per_seg;
+	bool done;
+
+retry:
+	spin_lock(&sm_i->issue_lock);
+	done = __drop_discard(sm_i, start, end, &new);
+	spin_unlock(&sm_i->issue_lock);
+
+	if (!done) {
+		new = f2fs_kmem_cache_alloc(discard_entry_slab, GFP_NOFS);
+		INIT_LIST_HEAD(&new->list);
+		goto retry;
+	}
+	if (new)
+		kmem_cache_free(discard_entry_slab, new);
+
+	wait_event(sm_i->discard_done_wq, !discard_in_flight(sm_i, start, end));
+}
+
+/*
+ * Send up to @max_blocks of queued discards, front to back, in commands of
+ * at most discard_batch blocks. Returns the number of blocks sent.
+ */
+static unsigned int issue_discard_cmds(struct f2fs_sb_info *sbi,
+						unsigned int max_blocks)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	unsigned int batch = sm_i->discard_batch;
+	unsigned int issued = 0;
+
+	mutex_lock(&sm_i->issue_mutex);
+	while (issued < max_blocks) {
+		struct discard_entry *entry;
+		block_t blkaddr;
+		unsigned int len;
+
+		spin_lock(&sm_i->issue_lock);
+		if (list_empty(&sm_i->issue_list)) {
+			spin_unlock(&sm_i->issue_lock);
+			break;
+		}
+		entry = list_first_entry(&sm_i->issue_list,
+					struct discard_entry, list);
+		blkaddr = entry->blkaddr;
+		len = min_t(unsigned int, entry->len, max_blocks - issued);
+		len = min(len, batch);
+
+		entry->blkaddr += len;
+		entry->len -= len;
+		sm_i->nr_issue -= len;
+		if (entry->len)
+			entry = NULL;
+		else
+			list_del(&entry->list);
+
+		sm_i->issuing_blkaddr = blkaddr;
+		sm_i->issuing_len = len;
+		spin_unlock(&sm_i->issue_lock);
+
+		if (entry)
+			kmem_cache_free(discard_entry_slab, entry);
+
+		f2fs_issue_discard(sbi, blkaddr, len);
+
+		spin_lock(&sm_i->issue_lock);
+		sm_i->issuing_len = 0;
+		spin_unlock(&sm_i->issue_lock);
+		wake_up_all(&sm_i->discard_done_wq);
+
+		issued += len;
+		cond_resched();
+	}
+	mutex_unlock(&sm_i->issue_mutex);
+
+	return issued;
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	wait_queue_head_t *q = &sm_i->discard_wait_queue;
+	bool urgent;
+
+	set_freezable();
+	do {
+		if (try_to_freeze())
+			continue;
+
+		issue_discard_cmds(sbi, sm_i->discard_batch);
+
+		/* FITRIM asked for the queue without pauses until it empties */
+		spin_lock(&sm_i->issue_lock);
+		if (list_empty(&sm_i->issue_list))
+			sm_i->discard_urgent = false;
+		urgent = sm_i->discard_urgent;
+		spin_unlock(&sm_i->issue_lock);
+		if (urgent)
+			continue;
+
+		/* rate control: pause between rounds while work remains */
+		if (!list_empty(&sm_i->issue_list))
+			wait_event_freezable_timeout(*q,
+				kthread_should_stop() || sm_i->discard_urgent,
+				msecs_to_jiffies(sm_i->discard_interval));
+		else
+			wait_event_freezable(*q, kthread_should_stop() ||
+				!list_empty(&sm_i->issue_list));
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+/*
+ * The thread is started on mounts with the discard option, and by the first
+ * FITRIM otherwise.
+ */
+int start_discard_thread(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct task_struct *task;
+	int err = 0;
+
+	mutex_lock(&sm_i->issue_mutex);
+	if (!sm_i->discard_task) {
+		task = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+		if (IS_ERR(task))
+			err = PTR_ERR(task);
+		else
+			sm_i->discard_task = task;
+	}
+	mutex_unlock(&sm_i->issue_mutex);
+	return err;
+}
+
+static void wake_up_discard_thread(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+
+	if (sm_i->discard_task)
+		wake_up_interruptible_all(&sm_i->discard_wait_queue);
+	else
+		issue_discard_cmds(sbi, UINT_MAX);
+}
+
 static void add_discard_addrs(struct f2fs_sb_info *sbi,
 			unsigned int segno, struct seg_entry *se)
 {
@@ -363,18 +662,107 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi)
 		if (!test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
-	/* send small discards */
+	/* queue small discards, except in segments that are being filled */
 	list_for_each_entry_safe(entry, this, head, list) {
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		if (!IS_CURSEG(sbi, GET_SEGNO(sbi, entry->blkaddr)))
+			f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		list_del(&entry->list);
 		SM_I(sbi)->nr_discards -= entry->len;
 		kmem_cache_free(discard_entry_slab, entry);
 	}
+
+	if (!list_empty(&SM_I(sbi)->issue_list))
+		wake_up_discard_thread(sbi);
+}
+
+/*
+ * Discard the free segments in the given range. Prefree segments are made
+ * free by a checkpoint first. The range is only queued here: the discard
+ * thread sends it in batches, without pausing between them, so that
+ * writers never wait behind more than one batch.
+ */
+int f2fs_trim_fs(struct f2fs_sb_info *sbi, struct fstrim_range *range)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+	struct free_segmap_info *free_i = FREE_I(sbi);
+	__u64 start = range->start >> sbi->log_blocksize;
+	__u64 end = start + (range->len >> sbi->log_blocksize) - 1;
+	__u64 max_blks = le64_to_cpu(F2FS_RAW_SUPER(sbi)->block_count);
+	unsigned int minlen = range->minlen >> sbi->log_blocksize;
+	unsigned int segno, end_segno;
+	struct discard_entry *new = NULL;
+	block_t trimmed = 0;
+
+	range->len >>= sbi->log_blocksize;
+	if (!range->len || start >= max_blks)
+		return -EINVAL;
+	range->len = 0;
+
+	if (end >= max_blks)
+		end = max_blks - 1;
+	if (end < MAIN_BASE_BLOCK(sbi))
+		goto out;
+
+	segno = start < MAIN_BASE_BLOCK(sbi) ? 0 : GET_SEGNO(sbi, start);
+	end_segno = GET_SEGNO(sbi, end);
+	if (end_segno >= TOTAL_SEGS(sbi))
+		end_segno = TOTAL_SEGS(sbi) - 1;
+
+	mutex_lock(&sbi->gc_mutex);
+	write_checkpoint(sbi, false);
+	mutex_unlock(&sbi->gc_mutex);
+
+	while (segno <= end_segno) {
+		unsigned int next;
+		block_t len;
+
+		if (!new)
+			new = f2fs_kmem_cache_alloc(discard_entry_slab,
+								GFP_NOFS);
+
+		/*
+		 * Check and queue atomically against reset_curseg() dropping
+		 * a segment it has just taken from the free segmap.
+		 */
+		spin_lock(&sm_i->issue_lock);
+		read_lock(&free_i->segmap_lock);
+		segno = find_next_zero_bit(free_i->free_segmap,
+						end_segno + 1, segno);
+		next = find_next_bit(free_i->free_segmap,
+						end_segno + 1, segno);
+		read_unlock(&free_i->segmap_lock);
+
+		len = (next - segno) << sbi->log_blocks_per_seg;
+		if (segno <= end_segno && len >= minlen) {
+			__insert_discard(sm_i, START_BLOCK(sbi, segno),
+								len, &new);
+			trimmed += len;
+		}
+		spin_unlock(&sm_i->issue_lock);
+
+		segno = next;
+		cond_resched();
+	}
+	if (new)
+		kmem_cache_free(discard_entry_slab, new);
+
+	if (trimmed) {
+		spin_lock(&sm_i->issue_lock);
+		sm_i->discard_urgent = true;
+		spin_unlock(&sm_i->issue_lock);
+
+		/* without the thread, the queue is sent from here */
+		start_discard_thread(sbi);
+		wake_up_discard_thread(sbi);
+	}
+out:
+	range->len = (__u64)trimmed << sbi->log_blocksize;
+	return 0;
 }
 
 static void __mark_sit_entry_dirty(struct f2fs_sb_info *sbi, unsigned int segno)
@@ -628,6 +1016,7 @@ static void reset_curseg(struct f2fs_sb_info *sbi, int type, int modified)
 
 	curseg->segno = curseg->next_segno;
 	curseg->zone = GET_ZONENO_FROM_SEGNO(sbi, curseg->segno);
+	f2fs_wait_discard(sbi, curseg->segno);
 	curseg->next_blkoff = 0;
 	curseg->next_segno = NULL_SEGNO;
 
@@ -803,6 +1192,12 @@ static int __get_segment_type_2(struct page *page, enum page_type p_type)
 		return CURSEG_HOT_NODE;
 }
 
+static inline bool is_hot_data(struct inode *inode)
+{
+	return file_is_hot(inode) ||
+		is_inode_flag_set(F2FS_I(inode), FI_HOT_DATA);
+}
+
 static int __get_segment_type_4(struct page *page, enum page_type p_type)
 {
 	if (p_type == DATA) {
@@ -810,6 +1205,10 @@ static int __get_segment_type_4(struct page *page, enum page_type p_type)
 
 		if (S_ISDIR(inode->i_mode))
 			return CURSEG_HOT_DATA;
+		else if (is_cold_data(page) || file_is_cold(inode))
+			return CURSEG_COLD_DATA;
+		else if (is_hot_data(inode))
+			return CURSEG_HOT_DATA;
 		else
 			return CURSEG_COLD_DATA;
 	} else {
@@ -829,6 +1228,8 @@ static int __get_segment_type_6(struct page *page, enum page_type p_type)
 			return CURSEG_HOT_DATA;
 		else if (is_cold_data(page) || file_is_cold(inode))
 			return CURSEG_COLD_DATA;
+		else if (is_hot_data(inode))
+			return CURSEG_HOT_DATA;
 		else
 			return CURSEG_WARM_DATA;
 	} else {
@@ -880,6 +1281,7 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	__refresh_next_blkoff(sbi, curseg);
 
 	stat_inc_block_count(sbi, curseg);
+	stat_inc_log_block_count(sbi, type);
 
 	if (!__has_curseg_space(sbi, type))
 		sit_i->s_ops->allocate_segment(sbi, type, false);
@@ -949,9 +1351,39 @@ void rewrite_data_page(struct page *page, block_t old_blkaddr,
 {
 	struct inode *inode = page->mapping->host;
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+
+	stat_inc_inplace_blocks(sbi);
 	f2fs_submit_page_mbio(sbi, page, old_blkaddr, fio);
 }
 
+/*
+ * Called once per writeback of a file that overwrote existing data blocks.
+ * A file updated at least hot_update_thresh times within one
+ * hot_update_interval is treated as hot and its data goes to the hot
+ * data log, until an interval passes with fewer updates.
+ */
+void f2fs_update_hotness(struct inode *inode)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct f2fs_sm_info *sm_i = SM_I(F2FS_SB(inode->i_sb));
+	unsigned long interval = msecs_to_jiffies(sm_i->hot_update_interval);
+
+	if (!sm_i->hot_update_thresh)
+		return;
+
+	if (time_after(jiffies, fi->i_update_stamp + interval)) {
+		/* an idle interval in between also cools the file down */
+		if (fi->i_update_count < sm_i->hot_update_thresh ||
+			time_after(jiffies, fi->i_update_stamp + 2 * interval))
+			clear_inode_flag(fi, FI_HOT_DATA);
+		fi->i_update_stamp = jiffies;
+		fi->i_update_count = 0;
+	}
+
+	if (++fi->i_update_count >= sm_i->hot_update_thresh)
+		set_inode_flag(fi, FI_HOT_DATA);
+}
+
 void recover_data_page(struct f2fs_sb_info *sbi,
 			struct page *page, struct f2fs_summary *sum,
 			block_t old_blkaddr, block_t new_blkaddr)
@@ -1785,11 +2217,24 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 					DEF_RECLAIM_PREFREE_SEGMENTS / 100;
 	sm_info->ipu_policy = F2FS_IPU_DISABLE;
 	sm_info->min_ipu_util = DEF_MIN_IPU_UTIL;
+	sm_info->hot_update_thresh = DEF_HOT_UPDATE_THRESH;
+	sm_info->hot_update_interval = DEF_HOT_UPDATE_INTERVAL;
 
 	INIT_LIST_HEAD(&sm_info->discard_list);
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
 
+	init_waitqueue_head(&sm_info->discard_wait_queue);
+	init_waitqueue_head(&sm_info->discard_done_wq);
+	spin_lock_init(&sm_info->issue_lock);
+	mutex_init(&sm_info->issue_mutex);
+	INIT_LIST_HEAD(&sm_info->issue_list);
+	sm_info->nr_issue = 0;
+	sm_info->issuing_len = 0;
+	sm_info->discard_urgent = false;
+	sm_info->discard_batch = DEF_DISCARD_BATCH;
+	sm_info->discard_interval = DEF_DISCARD_INTERVAL;
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -1809,6 +2254,11 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 		return err;
 
 	init_min_max_mtime(sbi);
+
+	/* without the thread, discards are sent at checkpoint */
+	if (test_opt(sbi, DISCARD) &&
+	    blk_queue_discard(bdev_get_queue(sbi->sb->s_bdev)))
+		start_discard_thread(sbi);
 	return 0;
 }
 
@@ -1898,6 +2348,11 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	struct f2fs_sm_info *sm_info = SM_I(sbi);
 	if (!sm_info)
 		return;
+	if (sm_info->discard_task) {
+		kthread_stop(sm_info->discard_task);
+		sm_info->discard_task = NULL;
+	}
+	issue_discard_cmds(sbi, UINT_MAX);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -16,6 +16,9 @@
 
 #define DEF_RECLAIM_PREFREE_SEGMENTS	5	/* 5% over total segments */
 
+#define DEF_DISCARD_BATCH		4096	/* blocks issued per round */
+#define DEF_DISCARD_INTERVAL		50	/* msecs between rounds */
+
 /* L: Logical segment # in volume, R: Relative segment # in main area */
 #define GET_L2R_SEGNO(free_i, segno)	(segno - free_i->start_segno)
 #define GET_R2L_SEGNO(free_i, segno)	(segno + free_i->start_segno)
@@ -470,6 +473,10 @@ static inline int utilization(struct f2fs_sb_info *sbi)
  */
 #define DEF_MIN_IPU_UTIL	70
 
+/* a file overwritten this many times within the interval is hot data */
+#define DEF_HOT_UPDATE_THRESH		16
+#define DEF_HOT_UPDATE_INTERVAL		5000	/* 5 secs */
+
 enum {
 	F2FS_IPU_FORCE,
 	F2FS_IPU_SSR,
@@ -133,6 +133,9 @@ static ssize_t f2fs_sbi_store(struct f2fs_attr *a,
 	ret = kstrtoul(skip_spaces(buf), 0, &t);
 	if (ret < 0)
 		return ret;
+	/* the discard thread would spin without issuing anything */
+	if (!t && !strcmp(a->attr.name, "discard_batch"))
+		return -EINVAL;
 	*ui = t;
 	return count;
 }
@@ -182,10 +185,19 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_min_sleep_time, min_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_max_sleep_time, max_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent_sleep_time,
+							urgent_sleep_time);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle_interval, idle_interval);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent_free_secs,
+							urgent_free_secs);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_small_discards, max_discards);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, discard_batch, discard_batch);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, discard_interval, discard_interval);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_ipu_util, min_ipu_util);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, hot_update_thresh, hot_update_thresh);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, hot_update_interval, hot_update_interval);
 F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, ram_thresh, ram_thresh);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
@@ -196,10 +208,17 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_max_sleep_time),
 	ATTR_LIST(gc_no_gc_sleep_time),
 	ATTR_LIST(gc_idle),
+	ATTR_LIST(gc_urgent_sleep_time),
+	ATTR_LIST(gc_idle_interval),
+	ATTR_LIST(gc_urgent_free_secs),
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
+	ATTR_LIST(discard_batch),
+	ATTR_LIST(discard_interval),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
+	ATTR_LIST(hot_update_thresh),
+	ATTR_LIST(hot_update_interval),
 	ATTR_LIST(max_victim_search),
 	ATTR_LIST(dir_level),
 	ATTR_LIST(ram_thresh),
@@ -359,6 +378,8 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
 	atomic_set(&fi->dirty_dents, 0);
 	fi->i_current_depth = 1;
 	fi->i_advise = 0;
+	fi->i_update_count = 0;
+	fi->i_update_stamp = jiffies;
 	rwlock_init(&fi->ext.ext_lock);
 	init_rwsem(&fi->i_sem);
 
@@ -606,6 +627,10 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		if (err)
 			goto restore_opts;
 	}
+
+	if (!(*flags & MS_RDONLY) && test_opt(sbi, DISCARD) &&
+	    blk_queue_discard(bdev_get_queue(sb->s_bdev)))
+		start_discard_thread(sbi);
 skip:
 	/* Update the POSIXACL Flag */
 	 sb->s_flags = (sb->s_flags & ~MS_POSIXACL) |
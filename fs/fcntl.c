@@ -420,6 +420,11 @@ static long do_fcntl(int fd, unsigned int cmd, unsigned long arg,
 	case F_GETPIPE_SZ:
 		err = pipe_fcntl(filp, cmd, arg);
 		break;
+	case F_SET_RA_TRACE:
+	case F_GET_RA_TRACE:
+	case F_RA_REPLAY:
+		err = ra_trace_fcntl(filp, cmd, arg);
+		break;
 	default:
 		break;
 	}
@@ -786,6 +786,13 @@ static void fuse_fillattr(struct inode *inode, struct fuse_attr *attr,
 	stat->size = attr->size;
 	stat->blocks = attr->blocks;
 	stat->blksize = (1 << inode->i_blkbits);
+
+	/* see the comment in fuse_change_attributes() */
+	if (get_fuse_conn(inode)->writeback_cache && S_ISREG(inode->i_mode)) {
+		stat->size = i_size_read(inode);
+		stat->mtime = inode->i_mtime;
+		stat->ctime = inode->i_ctime;
+	}
 }
 
 static int fuse_do_getattr(struct inode *inode, struct kstat *stat,
@@ -1358,7 +1365,22 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	if (!fc->writeback_cache || !S_ISREG(inode->i_mode)) {
+		i_size_write(inode, outarg.attr.size);
+	} else {
+		/*
+		 * Cached size and mtime are kernel owned, only take them
+		 * from the reply if this request actually changed them
+		 */
+		if (is_truncate)
+			i_size_write(inode, outarg.attr.size);
+		if (attr->ia_valid & (ATTR_MTIME | ATTR_SIZE)) {
+			inode->i_mtime.tv_sec = outarg.attr.mtime;
+			inode->i_mtime.tv_nsec = outarg.attr.mtimensec;
+			inode->i_ctime.tv_sec = outarg.attr.ctime;
+			inode->i_ctime.tv_nsec = outarg.attr.ctimensec;
+		}
+	}
 
 	if (is_truncate) {
 		/* NOTE: this may release/reacquire fc->lock */
@@ -1370,8 +1392,8 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	 * Only call invalidate_inode_pages2() after removing
 	 * FUSE_NOWRITE, otherwise fuse_launder_page() would deadlock.
 	 */
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
-		truncate_pagecache(inode, oldsize, outarg.attr.size);
+	if (S_ISREG(inode->i_mode) && oldsize != inode->i_size) {
+		truncate_pagecache(inode, oldsize, inode->i_size);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 
@@ -1384,6 +1406,44 @@ error:
 	return err;
 }
 
+/*
+ * Send the cached mtime of a writeback cache inode to the filesystem
+ */
+int fuse_flush_mtime(struct inode *inode)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_req *req;
+	struct fuse_setattr_in inarg;
+	struct fuse_attr_out outarg;
+	int err;
+
+	req = fuse_get_req(fc);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	memset(&inarg, 0, sizeof(inarg));
+	memset(&outarg, 0, sizeof(outarg));
+	inarg.valid = FATTR_MTIME;
+	inarg.mtime = inode->i_mtime.tv_sec;
+	inarg.mtimensec = inode->i_mtime.tv_nsec;
+	req->in.h.opcode = FUSE_SETATTR;
+	req->in.h.nodeid = get_node_id(inode);
+	req->in.numargs = 1;
+	req->in.args[0].size = sizeof(inarg);
+	req->in.args[0].value = &inarg;
+	req->out.numargs = 1;
+	if (fc->minor < 9)
+		req->out.args[0].size = FUSE_COMPAT_ATTR_OUT_SIZE;
+	else
+		req->out.args[0].size = sizeof(outarg);
+	req->out.args[0].value = &outarg;
+	fuse_request_send(fc, req);
+	err = req->out.h.error;
+	fuse_put_request(fc, req);
+
+	return err;
+}
+
 static int fuse_setattr(struct dentry *entry, struct iattr *attr)
 {
 	if (attr->ia_valid & ATTR_FILE)
@@ -184,6 +184,9 @@ int inode_init_always(struct super_block *sb, struct inode *inode)
 	mapping->flags = 0;
 	mapping_set_gfp_mask(mapping, GFP_HIGHUSER_MOVABLE);
 	mapping->assoc_mapping = NULL;
+#ifdef CONFIG_READAHEAD_TRACE
+	mapping->ra_trace = NULL;
+#endif
 	mapping->backing_dev_info = &default_backing_dev_info;
 	mapping->writeback_index = 0;
 
@@ -248,6 +251,7 @@ EXPORT_SYMBOL(free_inode_nonrcu);
 void __destroy_inode(struct inode *inode)
 {
 	BUG_ON(inode_has_buffers(inode));
+	ra_trace_free(&inode->i_data);
 	security_inode_free(inode);
 	fsnotify_inode_delete(inode);
 #ifdef CONFIG_FS_POSIX_ACL
@@ -463,10 +467,16 @@ static void evict(struct inode *inode)
 	inode_wb_list_del(inode);
 	inode_sb_list_del(inode);
 
+	/*
+	 * Reclaim must stop leaving shadow entries behind before the
+	 * final truncate, or they would outlive the mapping.
+	 */
+	mapping_set_exiting(&inode->i_data);
+
 	if (op->evict_inode) {
 		op->evict_inode(inode);
 	} else {
-		if (inode->i_data.nrpages)
+		if (inode->i_data.nrpages || inode->i_data.nrshadows)
 			truncate_inode_pages(&inode->i_data, 0);
 		end_writeback(inode);
 	}
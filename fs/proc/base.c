@@ -83,6 +83,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/fs_struct.h>
 #include <linux/slab.h>
+#include <linux/ksm.h>
 #ifdef CONFIG_HARDWALL
 #include <asm/hardwall.h>
 #endif
@@ -2741,6 +2742,35 @@ static int proc_pid_personality(struct seq_file *m, struct pid_namespace *ns,
 	return err;
 }
 
+#ifdef CONFIG_KSM
+/*
+ * Scan statistics of ksmd for the mm: how many pages it scanned and merged,
+ * how long that took, and the resulting merge yield.
+ */
+static int proc_pid_ksm_stat(struct seq_file *m, struct pid_namespace *ns,
+			     struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+	unsigned long scanned = 0, merged = 0;
+	u64 time = 0, yield = 0;
+
+	if (mm) {
+		ksm_mm_stat(mm, &scanned, &merged, &time);
+		mmput(mm);
+	}
+	if (time)
+		yield = div64_u64((u64)merged * NSEC_PER_SEC, time);
+
+	seq_printf(m, "ksm_pages_scanned %lu\n", scanned);
+	seq_printf(m, "ksm_pages_merged %lu\n", merged);
+	seq_printf(m, "ksm_scan_time_ms %llu\n",
+		   (unsigned long long)div_u64(time, NSEC_PER_MSEC));
+	seq_printf(m, "ksm_merges_per_cpu_sec %llu\n",
+		   (unsigned long long)yield);
+	return 0;
+}
+#endif /* CONFIG_KSM */
+
 /*
  * Thread groups
  */
@@ -2813,6 +2843,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	INF("oom_score",  S_IRUGO, proc_oom_score),
 	ANDROID("oom_adj",S_IRUGO|S_IWUSR, oom_adjust),
 	REG("oom_score_adj", S_IRUGO|S_IWUSR, proc_oom_score_adj_operations),
+#ifdef CONFIG_KSM
+	ONE("ksm_stat",   S_IRUGO, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_AUDITSYSCALL
 	REG("loginuid",   S_IWUSR|S_IRUGO, proc_loginuid_operations),
 	REG("sessionid",  S_IRUGO, proc_sessionid_operations),
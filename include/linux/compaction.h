@@ -56,6 +56,23 @@ static inline bool compaction_deferred(struct zone *zone)
 	return zone->compact_considered < (1UL << zone->compact_defer_shift);
 }
 
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx);
+extern int kcompactd_run(int nid);
+extern void kcompactd_stop(int nid);
+
+/*
+ * A high-order allocation was served from the fast path by a zone that
+ * kcompactd compacted ahead of time: one direct compaction stall saved.
+ * Only the first such allocation after each kcompactd run is counted.
+ */
+static inline void compaction_count_avoided(struct zone *zone, int order)
+{
+	if (unlikely(zone->compact_ready_order >= order)) {
+		zone->compact_ready_order = 0;
+		count_vm_event(COMPACTSTALL_AVOIDED);
+	}
+}
+
 #else
 static inline unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *nodemask,
@@ -84,6 +101,24 @@ static inline bool compaction_deferred(struct zone *zone)
 	return 1;
 }
 
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order,
+				    int classzone_idx)
+{
+}
+
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop(int nid)
+{
+}
+
+static inline void compaction_count_avoided(struct zone *zone, int order)
+{
+}
+
 #endif /* CONFIG_COMPACTION */
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
@@ -1,6 +1,7 @@
 #ifndef _LINUX_FCNTL_H
 #define _LINUX_FCNTL_H
 
+#include <linux/types.h>
 #include <asm/fcntl.h>
 
 #define F_SETLEASE	(F_LINUX_SPECIFIC_BASE + 0)
@@ -27,6 +28,25 @@
 #define F_SETPIPE_SZ	(F_LINUX_SPECIFIC_BASE + 7)
 #define F_GETPIPE_SZ	(F_LINUX_SPECIFIC_BASE + 8)
 
+/*
+ * Record the pages of a file faulted in through mmap, fetch the trace,
+ * and read the pages of a trace back in.  See struct f_ra_trace.
+ */
+#define F_SET_RA_TRACE	(F_LINUX_SPECIFIC_BASE + 16)
+#define F_GET_RA_TRACE	(F_LINUX_SPECIFIC_BASE + 17)
+#define F_RA_REPLAY	(F_LINUX_SPECIFIC_BASE + 18)
+
+struct f_ra_range {
+	__u64	start;		/* first page */
+	__u64	nr_pages;
+};
+
+struct f_ra_trace {
+	__u32	nr_ranges;	/* room in ranges[] / ranges filled in */
+	__u32	flags;		/* must be zero */
+	struct f_ra_range ranges[0];
+};
+
 /*
  * Types of directory notifications that may be requested.
  */
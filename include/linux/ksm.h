@@ -38,6 +38,16 @@ static inline void ksm_exit(struct mm_struct *mm)
 		__ksm_exit(mm);
 }
 
+static inline void ksm_mm_init(struct mm_struct *mm)
+{
+	mm->ksm_pages_scanned = 0;
+	mm->ksm_pages_merged = 0;
+	mm->ksm_scan_time = 0;
+}
+
+void ksm_mm_stat(struct mm_struct *mm, unsigned long *scanned,
+		 unsigned long *merged, u64 *time);
+
 /*
  * A KSM page is one of those write-protected "shared pages" or "merged pages"
  * which KSM maps into multiple mms, wherever identical anonymous page content
@@ -101,6 +111,10 @@ static inline void ksm_exit(struct mm_struct *mm)
 {
 }
 
+static inline void ksm_mm_init(struct mm_struct *mm)
+{
+}
+
 static inline int PageKsm(struct page *page)
 {
 	return 0;
@@ -153,6 +153,11 @@ static inline void mem_cgroup_dec_page_stat(struct page *page,
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask,
 						unsigned long *total_scanned);
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, int priority,
+					  gfp_t gfp_mask,
+					  unsigned long *total_scanned);
+void mem_cgroup_count_reclaim(struct mem_cgroup *mem, unsigned long scanned,
+			      unsigned long reclaimed);
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
@@ -358,6 +363,20 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, int priority,
+					  gfp_t gfp_mask,
+					  unsigned long *total_scanned)
+{
+	return 0;
+}
+
+static inline void mem_cgroup_count_reclaim(struct mem_cgroup *mem,
+					    unsigned long scanned,
+					    unsigned long reclaimed)
+{
+}
+
 static inline
 u64 mem_cgroup_get_limit(struct mem_cgroup *mem)
 {
@@ -1493,6 +1493,22 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+#ifdef CONFIG_READAHEAD_TRACE
+void __ra_trace_record(struct address_space *mapping, pgoff_t index);
+long ra_trace_fcntl(struct file *filp, unsigned int cmd, unsigned long arg);
+void ra_trace_free(struct address_space *mapping);
+#else
+static inline long ra_trace_fcntl(struct file *filp, unsigned int cmd,
+				  unsigned long arg)
+{
+	return -EINVAL;
+}
+
+static inline void ra_trace_free(struct address_space *mapping)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
@@ -86,9 +86,12 @@ struct page {
 		pgoff_t index;		/* Our offset within mapping. */
 		void *freelist;		/* SLUB: freelist req. slab lock */
 	};
-	struct list_head lru;		/* Pageout list, eg. active_list
+	union {
+		struct list_head lru;	/* Pageout list, eg. active_list
 					 * protected by zone->lru_lock !
 					 */
+		struct page *next;	/* SLUB: next per cpu partial slab */
+	};
 	/*
 	 * On machines where all RAM is mapped into kernel address space,
 	 * we can simply calculate the virtual address. On machines with
@@ -192,6 +195,9 @@ struct vm_area_struct {
 	struct file * vm_file;		/* File we map to (can be NULL). */
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 
+#ifdef CONFIG_SWAP
+	unsigned long swap_readahead_info; /* last fault, window and hits */
+#endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -330,6 +336,12 @@ struct mm_struct {
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
+#ifdef CONFIG_KSM
+	/* Protected by ksm_thread_mutex, see /proc/<pid>/ksm_stat */
+	unsigned long ksm_pages_scanned;
+	unsigned long ksm_pages_merged;
+	u64 ksm_scan_time;		/* in nanoseconds */
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
@@ -3,6 +3,7 @@
 
 /* For now we just replace the xt_owner.
  * FIXME: make iptables aware of qtaguid. */
+#include <linux/types.h>
 #include <linux/netfilter/xt_owner.h>
 
 #define XT_QTAGUID_UID    XT_OWNER_UID
@@ -10,4 +11,63 @@
 #define XT_QTAGUID_SOCKET XT_OWNER_SOCKET
 #define xt_qtaguid_match_info xt_owner_match_info
 
+/*
+ * Binary stats export over generic netlink.
+ *
+ * A QTAGUID_CMD_GET_STATS dump returns one message per interface total
+ * (QTAGUID_A_IFACE_STATS) and per {acct_tag, uid} stat (QTAGUID_A_STATS),
+ * along with QTAGUID_A_IFNAME and the generation of the dump in
+ * QTAGUID_A_GEN.
+ * If the request has QTAGUID_A_SINCE_GEN, only the entries whose counters
+ * changed since the dump that returned that generation are included.
+ * Otherwise every entry is, including those without any traffic yet.
+ */
+#define QTAGUID_GENL_NAME	"qtaguid"
+#define QTAGUID_GENL_VERSION	1
+
+enum {
+	QTAGUID_CMD_UNSPEC,
+	QTAGUID_CMD_GET_STATS,
+	__QTAGUID_CMD_MAX,
+};
+#define QTAGUID_CMD_MAX (__QTAGUID_CMD_MAX - 1)
+
+enum {
+	QTAGUID_A_UNSPEC,
+	QTAGUID_A_SINCE_GEN,	/* u32 */
+	QTAGUID_A_GEN,		/* u32 */
+	QTAGUID_A_IFNAME,	/* string */
+	QTAGUID_A_IFACE_STATS,	/* struct qtaguid_stats, set 0 only */
+	QTAGUID_A_STATS,	/* struct qtaguid_stats */
+	__QTAGUID_A_MAX,
+};
+#define QTAGUID_A_MAX (__QTAGUID_A_MAX - 1)
+
+#define QTAGUID_MAX_COUNTER_SETS	2
+enum {
+	QTAGUID_TX,
+	QTAGUID_RX,
+	QTAGUID_MAX_DIRECTIONS
+};
+enum {
+	QTAGUID_TCP,
+	QTAGUID_UDP,
+	QTAGUID_PROTO_OTHER,
+	QTAGUID_MAX_PROTOS
+};
+
+struct qtaguid_byte_packets {
+	__u64 bytes;
+	__u64 packets;
+};
+
+struct qtaguid_stats {
+	__u64 acct_tag;		/* Same as acct_tag_hex in the stats file */
+	__u32 uid;
+	__u32 pad;
+	struct qtaguid_byte_packets
+		bpc[QTAGUID_MAX_COUNTER_SETS][QTAGUID_MAX_DIRECTIONS]
+		   [QTAGUID_MAX_PROTOS];
+};
+
 #endif /* _XT_QTAGUID_MATCH_H */
@@ -106,6 +106,7 @@ enum {
 #define TCP_THIN_LINEAR_TIMEOUTS 16      /* Use linear timeouts for thin streams*/
 #define TCP_THIN_DUPACK         17      /* Fast retrans. after 1 dupack */
 #define TCP_USER_TIMEOUT	18	/* How long for loss retry before timeout */
+#define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
 
 /* for TCP_INFO socket option */
 #define TCPI_OPT_TIMESTAMPS	1
@@ -271,6 +272,17 @@ static inline void tcp_clear_options(struct tcp_options_received *rx_opt)
  * only four options will fit in a standard TCP header */
 #define TCP_NUM_SACKS 4
 
+/* TCP Fast Open */
+#define TCP_FASTOPEN_COOKIE_MIN	4	/* Min Fast Open Cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_MAX	16	/* Max Fast Open Cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_SIZE 8	/* the size employed by this impl. */
+
+/* TCP Fast Open Cookie as stored in memory */
+struct tcp_fastopen_cookie {
+	s8	len;
+	u8	val[TCP_FASTOPEN_COOKIE_MAX];
+};
+
 struct tcp_cookie_values;
 struct tcp_request_sock_ops;
 
@@ -280,8 +292,14 @@ struct tcp_request_sock {
 	/* Only used by TCP MD5 Signature so far. */
 	const struct tcp_request_sock_ops *af_specific;
 #endif
+	struct sock			*listener; /* Fast Open: listener the
+						    * child is accounted to
+						    */
 	u32				rcv_isn;
 	u32				snt_isn;
+	u32				rcv_nxt; /* ack# of our SYN-ACK, past
+						  * the data of a Fast Open SYN
+						  */
 };
 
 static inline struct tcp_request_sock *tcp_rsk(const struct request_sock *req)
@@ -460,6 +478,28 @@ struct tcp_sock {
 	 * contains related tcp_cookie_transactions fields.
 	 */
 	struct tcp_cookie_values  *cookie_values;
+
+	/* TCP Small Queues: see tcp_wfree() */
+	unsigned long	tsq_flags;
+	struct list_head tsq_node; /* anchor in tsq_tasklet.head list */
+
+	/* TCP Fast Open */
+	struct tcp_fastopen_request *fastopen_req;
+	/* Passive Fast Open child: the request its SYN-ACK is retransmitted
+	 * from until the three way handshake completes.
+	 */
+	struct request_sock *fastopen_rsk;
+	int	fastopen_max_qlen;	/* listener: TCP_FASTOPEN, 0 = off */
+	atomic_t fastopen_qlen;		/* listener: children still in SYN_RECV */
+	u8	syn_fastopen:1,	/* SYN includes Fast Open option */
+		syn_data:1,	/* SYN includes data */
+		syn_data_acked:1; /* data in SYN is acked by SYN-ACK */
+};
+
+enum tsq_flags {
+	TSQ_THROTTLED,	/* tcp_write_xmit() hit tcp_limit_output_bytes */
+	TSQ_QUEUED,	/* socket is on this cpu's tsq_tasklet list */
+	TSQ_OWNED,	/* tasklet found socket owned, tcp_release_cb() runs it */
 };
 
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
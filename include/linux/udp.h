@@ -77,6 +77,12 @@ struct udp_sock {
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
 	__u8		 unused[3];
+	/*
+	 * Route of the last send to an address given in msg_name, reused
+	 * while the flow stays the same.  Protected by sk_dst_lock.
+	 */
+	struct dst_entry *dst_cache;
+	struct flowi4	 dst_cache_key;
 	/*
 	 * For encapsulation sockets.
 	 */
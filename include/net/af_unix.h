@@ -12,7 +12,8 @@ extern void unix_gc(void);
 extern void wait_for_unix_gc(void);
 extern struct sock *unix_get_socket(struct file *filp);
 
-#define UNIX_HASH_SIZE	256
+#define UNIX_HASH_BITS	8
+#define UNIX_HASH_SIZE	(1 << UNIX_HASH_BITS)
 
 extern unsigned int unix_tot_inflight;
 
@@ -0,0 +1,226 @@
+/*
+ * kmem_cache microbenchmark
+ *
+ * For a few object sizes, runs a thread on each online CPU which
+ *  - allocates and frees one object at a time (the fastpaths),
+ *  - allocates a batch of objects and then frees them (the slowpaths and
+ *    the partial slab lists),
+ *  - frees the objects of its neighbour, allocated on another CPU (remote
+ *    frees),
+ * and reports the average cost of each in ns per operation.
+ *
+ *   modprobe test_kmem_cache loops=100000 batch=512
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+
+#include "test_threads.h"
+
+static unsigned int loops = 100000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Single alloc/free pairs per thread");
+
+static unsigned int batch = 512;
+module_param(batch, uint, 0444);
+MODULE_PARM_DESC(batch, "Objects per batch");
+
+static unsigned int nr_batches = 100;
+module_param(nr_batches, uint, 0444);
+MODULE_PARM_DESC(nr_batches, "Batches per thread");
+
+static const unsigned int test_sizes[] = { 64, 256, 1024, 2048 };
+
+enum {
+	TEST_SINGLE,		/* alloc + free pair */
+	TEST_BATCH_ALLOC,
+	TEST_BATCH_FREE,
+	TEST_REMOTE_FREE,
+	NR_TESTS
+};
+
+static const char * const test_names[NR_TESTS] = {
+	"alloc+free", "batch alloc", "batch free", "remote free",
+};
+
+struct test_slot {
+	void **objects;		/* freed by the next thread */
+	u64 ns[NR_TESTS];
+	int ret;
+};
+
+static struct kmem_cache *test_cache;
+static struct test_slot *slots;
+static unsigned int test_nr_threads;
+static atomic_t threads_allocated;
+
+/*
+ * Publish our batch, wait for every thread to have done the same, and free
+ * the batch of the next thread. Returns the time the frees took.
+ */
+static u64 test_free_next(struct test_slot *t)
+{
+	struct test_slot *next;
+	unsigned int i;
+	ktime_t start;
+
+	smp_mb__before_atomic_inc();
+	atomic_inc(&threads_allocated);
+	while (atomic_read(&threads_allocated) < test_nr_threads)
+		schedule();
+	smp_rmb();
+
+	next = &slots[(t - slots + 1) % test_nr_threads];
+	start = ktime_get();
+	for (i = 0; i < batch; i++)
+		if (next->objects[i])
+			kmem_cache_free(test_cache, next->objects[i]);
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void test_run(struct test_slot *t)
+{
+	unsigned int i, j;
+	ktime_t start;
+	void *p;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		p = kmem_cache_alloc(test_cache, GFP_KERNEL);
+		if (!p) {
+			t->ret = -ENOMEM;
+			return;
+		}
+		kmem_cache_free(test_cache, p);
+	}
+	t->ns[TEST_SINGLE] = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (j = 0; j < nr_batches; j++) {
+		start = ktime_get();
+		for (i = 0; i < batch; i++) {
+			t->objects[i] = kmem_cache_alloc(test_cache,
+							 GFP_KERNEL);
+			if (!t->objects[i]) {
+				while (i--)
+					kmem_cache_free(test_cache,
+							t->objects[i]);
+				t->ret = -ENOMEM;
+				return;
+			}
+		}
+		t->ns[TEST_BATCH_ALLOC] +=
+			ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		start = ktime_get();
+		for (i = 0; i < batch; i++)
+			kmem_cache_free(test_cache, t->objects[i]);
+		t->ns[TEST_BATCH_FREE] +=
+			ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+
+	/* Allocate a batch for the neighbour to free, and free its one */
+	for (i = 0; i < batch; i++) {
+		t->objects[i] = kmem_cache_alloc(test_cache, GFP_KERNEL);
+		if (!t->objects[i])
+			break;
+	}
+	for (; i < batch; i++)
+		t->objects[i] = NULL;
+
+	t->ns[TEST_REMOTE_FREE] = test_free_next(t);
+}
+
+static int test_kmem_cache_thread(unsigned int n)
+{
+	struct test_slot *t = &slots[n];
+
+	test_run(t);
+	if (t->ret) {
+		/* Leave nothing for the neighbour, but still free its batch */
+		memset(t->objects, 0, batch * sizeof(void *));
+		test_free_next(t);
+	}
+	return t->ret;
+}
+
+static int __init test_size(unsigned int size)
+{
+	u64 ns[NR_TESTS] = { 0, }, ops[NR_TESTS];
+	unsigned int n;
+	int i, ret = 0;
+
+	test_cache = kmem_cache_create("test_kmem_cache", size, 0, 0, NULL);
+	if (!test_cache)
+		return -ENOMEM;
+
+	memset(slots, 0, test_nr_threads * sizeof(*slots));
+	for (n = 0; n < test_nr_threads; n++) {
+		slots[n].objects = kmalloc(batch * sizeof(void *),
+					   GFP_KERNEL);
+		if (!slots[n].objects) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	atomic_set(&threads_allocated, 0);
+	ret = run_test_threads("test_kmem_cache", test_nr_threads,
+			       test_kmem_cache_thread);
+	if (ret)
+		goto out;
+
+	for (n = 0; n < test_nr_threads; n++)
+		for (i = 0; i < NR_TESTS; i++)
+			ns[i] += slots[n].ns[i];
+
+	ops[TEST_SINGLE] = (u64)loops * test_nr_threads;
+	ops[TEST_BATCH_ALLOC] = (u64)batch * nr_batches * test_nr_threads;
+	ops[TEST_BATCH_FREE] = ops[TEST_BATCH_ALLOC];
+	ops[TEST_REMOTE_FREE] = (u64)batch * test_nr_threads;
+
+	printk(KERN_INFO "test_kmem_cache: size %u, %u cpus:", size,
+	       test_nr_threads);
+	for (i = 0; i < NR_TESTS; i++)
+		printk(KERN_CONT " %s %llu ns%s", test_names[i],
+		       (unsigned long long)div64_u64(ns[i],
+						     max_t(u64, ops[i], 1)),
+		       i == NR_TESTS - 1 ? "\n" : ",");
+
+out:
+	for (n = 0; n < test_nr_threads; n++)
+		kfree(slots[n].objects);
+	kmem_cache_destroy(test_cache);
+	return ret;
+}
+
+static int __init test_kmem_cache_init(void)
+{
+	int i, ret = 0;
+
+	if (!loops || !batch || !nr_batches)
+		return -EINVAL;
+
+	test_nr_threads = num_online_cpus();
+	slots = kcalloc(test_nr_threads, sizeof(*slots), GFP_KERNEL);
+	if (!slots)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(test_sizes) && !ret; i++)
+		ret = test_size(test_sizes[i]);
+	kfree(slots);
+
+	if (ret) {
+		printk(KERN_ERR "test_kmem_cache: failed: %d\n", ret);
+		return ret;
+	}
+	return -EAGAIN;
+}
+module_init(test_kmem_cache_init);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,123 @@
+/*
+ * Page allocator microbenchmark
+ *
+ * Runs a thread on each online CPU which allocates a burst of order-0
+ * pages and then frees them all, in a loop, and reports the pages per
+ * second reached and the zone->lock round-trips the per-cpu lists took
+ * (pcp_refill and pcp_drain in /proc/vmstat) per thousand pages.  To see
+ * what the auto-tuning of the per-cpu lists saves, compare against a run
+ * with vm.percpu_pagelist_fraction set, which pins pcp->high and
+ * pcp->batch.
+ *
+ *   modprobe test_page_alloc burst=512 loops=2000
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/vmstat.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+
+#include "test_threads.h"
+
+static unsigned int burst = 256;
+module_param(burst, uint, 0444);
+MODULE_PARM_DESC(burst, "Pages allocated before they are freed again");
+
+static unsigned int loops = 1000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Bursts per thread");
+
+/* Time each thread took for its bursts */
+static u64 *thread_ns;
+
+static int test_page_alloc_thread(unsigned int t)
+{
+	struct page **pages;
+	unsigned int i, n;
+	ktime_t start;
+	int ret = 0;
+
+	pages = kmalloc(burst * sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		for (n = 0; n < burst; n++) {
+			pages[n] = alloc_page(GFP_KERNEL);
+			if (!pages[n]) {
+				ret = -ENOMEM;
+				break;
+			}
+		}
+		while (n--)
+			__free_page(pages[n]);
+		if (ret)
+			break;
+	}
+	thread_ns[t] = ktime_to_ns(ktime_sub(ktime_get(), start));
+	kfree(pages);
+	return ret;
+}
+
+static unsigned long pcp_lock_round_trips(void)
+{
+#ifdef CONFIG_VM_EVENT_COUNTERS
+	unsigned long events[NR_VM_EVENT_ITEMS];
+
+	all_vm_events(events);
+	return events[PCP_REFILL] + events[PCP_DRAIN];
+#else
+	return 0;
+#endif
+}
+
+static int __init test_page_alloc_init(void)
+{
+	unsigned int nr_threads = num_online_cpus();
+	unsigned long trips;
+	u64 ns = 0, pages, rate;
+	unsigned int n;
+	int ret;
+
+	if (!burst || !loops)
+		return -EINVAL;
+
+	thread_ns = kcalloc(nr_threads, sizeof(*thread_ns), GFP_KERNEL);
+	if (!thread_ns)
+		return -ENOMEM;
+
+	trips = pcp_lock_round_trips();
+	ret = run_test_threads("test_page_alloc", nr_threads,
+			       test_page_alloc_thread);
+	trips = pcp_lock_round_trips() - trips;
+
+	for (n = 0; n < nr_threads; n++)
+		ns = max(ns, thread_ns[n]);
+	kfree(thread_ns);
+
+	if (ret) {
+		printk(KERN_ERR "test_page_alloc: failed: %d\n", ret);
+		return ret;
+	}
+
+	pages = (u64)burst * loops * nr_threads;
+	ns = max_t(u64, ns, 1);
+	rate = div64_u64(pages * NSEC_PER_SEC, ns);
+	printk(KERN_INFO "test_page_alloc: %u threads x %u bursts of %u "
+	       "pages in %llu us, %llu pages/sec, %llu zone lock "
+	       "round-trips per 1000 pages\n", nr_threads, loops, burst,
+	       (unsigned long long)div_u64(ns, NSEC_PER_USEC),
+	       (unsigned long long)rate,
+	       (unsigned long long)div64_u64((u64)trips * 1000, pages));
+
+	return -EAGAIN;
+}
+module_init(test_page_alloc_init);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,106 @@
+/*
+ * Thread harness of the allocator microbenchmarks in lib/test_*.c
+ *
+ * run_test_threads() runs fn(0) ... fn(nr - 1) at the same time, each in a
+ * kthread bound to an online CPU, round robin, and waits for all of them.
+ * The benchmarks print their results from their init function and then
+ * fail it with -EAGAIN, so that the module never stays loaded.
+ */
+
+#ifndef _LIB_TEST_THREADS_H
+#define _LIB_TEST_THREADS_H
+
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+
+struct test_threads {
+	int (*fn)(unsigned int n);
+	atomic_t running;
+	struct completion done;
+};
+
+struct test_thread {
+	struct test_threads *set;
+	struct task_struct *task;
+	unsigned int n;
+	int ret;
+};
+
+static int test_thread_fn(void *data)
+{
+	struct test_thread *t = data;
+	struct test_threads *set = t->set;
+
+	t->ret = set->fn(t->n);
+	if (atomic_dec_and_test(&set->running))
+		complete(&set->done);
+
+	/* Wait to be stopped, so that kthread_stop() finds the task */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/*
+ * Returns the first error returned by a thread, or the error creating the
+ * threads, in which case none of them ran.
+ */
+static int __init run_test_threads(const char *name, unsigned int nr,
+				   int (*fn)(unsigned int n))
+{
+	struct test_threads set = { .fn = fn };
+	struct test_thread *threads;
+	unsigned int n, started;
+	int cpu, ret = 0;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	atomic_set(&set.running, nr);
+	init_completion(&set.done);
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (started = 0; started < nr; started++) {
+		struct test_thread *t = &threads[started];
+
+		t->set = &set;
+		t->n = started;
+		t->task = kthread_create(test_thread_fn, t, "%s/%u", name,
+					 started);
+		if (IS_ERR(t->task)) {
+			ret = PTR_ERR(t->task);
+			printk(KERN_ERR "%s: could only create %u threads\n",
+			       name, started);
+			break;
+		}
+		kthread_bind(t->task, cpu);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	if (!ret) {
+		for (n = 0; n < nr; n++)
+			wake_up_process(threads[n].task);
+		wait_for_completion(&set.done);
+	}
+
+	for (n = 0; n < started; n++) {
+		kthread_stop(threads[n].task);
+		if (!ret)
+			ret = threads[n].ret;
+	}
+	kfree(threads);
+	return ret;
+}
+
+#endif /* _LIB_TEST_THREADS_H */
@@ -0,0 +1,188 @@
+/*
+ * vmalloc stress test
+ *
+ * Runs a number of threads, one per online CPU by default, which
+ * allocate and free vmalloc and vm_map_ram areas in a loop, and reports
+ * how many allocations per second each test managed.
+ *
+ *   modprobe test_vmalloc nr_threads=4 loops=100000 test_mask=7
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+
+#include "test_threads.h"
+
+static unsigned int test_nr_threads;
+module_param_named(nr_threads, test_nr_threads, uint, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of threads (default: online CPUs)");
+
+static unsigned int loops = 10000;
+module_param(loops, uint, 0444);
+MODULE_PARM_DESC(loops, "Allocations per test and thread");
+
+static unsigned int test_mask = 0x7;
+module_param(test_mask, uint, 0444);
+MODULE_PARM_DESC(test_mask, "Tests to run: 1=fixed size, 2=random size, "
+		 "4=vm_map_ram");
+
+#define VM_MAP_PAGES	16
+
+static int fixed_size_test(void)
+{
+	unsigned int i;
+	void *p;
+
+	for (i = 0; i < loops; i++) {
+		p = vmalloc(3 * PAGE_SIZE);
+		if (!p)
+			return -ENOMEM;
+		*(u8 *)p = 0;
+		vfree(p);
+	}
+	return 0;
+}
+
+static int random_size_test(void)
+{
+	unsigned int i, n;
+	void *p;
+
+	for (i = 0; i < loops; i++) {
+		n = (random32() % 100) + 1;
+		p = vmalloc(n * PAGE_SIZE);
+		if (!p)
+			return -ENOMEM;
+		*(u8 *)p = 0;
+		vfree(p);
+	}
+	return 0;
+}
+
+static int vm_map_ram_test(void)
+{
+	struct page *pages[VM_MAP_PAGES];
+	unsigned int i;
+	int ret = 0;
+	void *p;
+
+	for (i = 0; i < VM_MAP_PAGES; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < loops; i++) {
+		p = vm_map_ram(pages, VM_MAP_PAGES, -1, PAGE_KERNEL);
+		if (!p) {
+			ret = -ENOMEM;
+			break;
+		}
+		*(u8 *)p = 0;
+		vm_unmap_ram(p, VM_MAP_PAGES);
+	}
+	i = VM_MAP_PAGES;
+out:
+	while (i--)
+		__free_page(pages[i]);
+	return ret;
+}
+
+static struct test_case {
+	const char *name;
+	int (*fn)(void);
+} test_cases[] = {
+	{ "fixed_size_alloc", fixed_size_test },
+	{ "random_size_alloc", random_size_test },
+	{ "vm_map_ram", vm_map_ram_test },
+};
+
+struct test_result {
+	u64 ns[ARRAY_SIZE(test_cases)];
+	int ret[ARRAY_SIZE(test_cases)];
+};
+
+static struct test_result *results;
+
+static int test_vmalloc_thread(unsigned int n)
+{
+	struct test_result *r = &results[n];
+	ktime_t start;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+		if (!(test_mask & (1 << i)))
+			continue;
+		start = ktime_get();
+		r->ret[i] = test_cases[i].fn();
+		r->ns[i] = ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+	return 0;
+}
+
+static void __init report(void)
+{
+	unsigned int n;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+		u64 ns, rate;
+		int ret = 0;
+
+		if (!(test_mask & (1 << i)))
+			continue;
+
+		ns = 0;
+		for (n = 0; n < test_nr_threads; n++) {
+			ns = max(ns, results[n].ns[i]);
+			if (results[n].ret[i])
+				ret = results[n].ret[i];
+		}
+		if (ret) {
+			printk(KERN_ERR "test_vmalloc: %s failed: %d\n",
+			       test_cases[i].name, ret);
+			continue;
+		}
+
+		ns = max_t(u64, ns, 1);
+		rate = div64_u64((u64)loops * test_nr_threads * NSEC_PER_SEC,
+				 ns);
+		printk(KERN_INFO "test_vmalloc: %s: %u threads x %u loops "
+		       "in %llu us, %llu allocs/sec\n", test_cases[i].name,
+		       test_nr_threads, loops,
+		       (unsigned long long)div_u64(ns, NSEC_PER_USEC),
+		       (unsigned long long)rate);
+	}
+}
+
+static int __init test_vmalloc_init(void)
+{
+	int ret;
+
+	if (!test_nr_threads)
+		test_nr_threads = num_online_cpus();
+
+	results = kcalloc(test_nr_threads, sizeof(*results), GFP_KERNEL);
+	if (!results)
+		return -ENOMEM;
+
+	ret = run_test_threads("test_vmalloc", test_nr_threads,
+			       test_vmalloc_thread);
+	if (!ret)
+		report();
+	kfree(results);
+
+	return ret ? ret : -EAGAIN;
+}
+module_init(test_vmalloc_init);
+
+MODULE_LICENSE("GPL");
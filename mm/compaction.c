@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -34,6 +36,7 @@ struct compact_control {
 	unsigned long free_pfn;		/* isolate_freepages search base */
 	unsigned long migrate_pfn;	/* isolate_migratepages search base */
 	bool sync;			/* Synchronous migration */
+	bool background;		/* kcompactd: any free block will do */
 
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
@@ -474,6 +477,10 @@ static int compact_finished(struct zone *zone,
 	if (!zone_watermark_ok(zone, cc->order, watermark, 0, 0))
 		return COMPACT_CONTINUE;
 
+	/* kcompactd is not allocating, a free block of any type is enough */
+	if (cc->background)
+		return COMPACT_PARTIAL;
+
 	/* Direct compactor: Is a suitable page free? */
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		/* Job done if page is free of the right migratetype */
@@ -764,3 +771,331 @@ void compaction_unregister_node(struct node *node)
 	return sysdev_remove_file(&node->sysdev, &attr_compact);
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
+
+/*
+ * kcompactd compacts ahead of demand, so that high-order allocations find
+ * free blocks instead of stalling in direct compaction.  There is one per
+ * node; it is woken by kswapd after a high-order wakeup and, every
+ * proactive_interval_ms, checks whether the fragmentation index for
+ * proactive_order has crossed proactive_threshold.
+ */
+static unsigned int kcompactd_interval_msecs = 5000;
+static unsigned int kcompactd_proactive_order = PAGE_ALLOC_COSTLY_ORDER;
+static unsigned int kcompactd_proactive_threshold = 500;
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+}
+
+/*
+ * Background runs use sync compaction, like the second pass of direct
+ * compaction: compact_zone() migrates with MIGRATE_SYNC_LIGHT, so
+ * kcompactd may wait on page locks and writeback but never calls
+ * ->writepage.
+ */
+static void kcompactd_compact_zone(struct zone *zone, int order)
+{
+	struct compact_control cc = {
+		.nr_freepages = 0,
+		.nr_migratepages = 0,
+		.order = order,
+		.migratetype = MIGRATE_UNMOVABLE,
+		.zone = zone,
+		.sync = true,
+		.background = true,
+	};
+	int status;
+
+	/* Nothing to gain if the allocation would already succeed */
+	if (compaction_suitable(zone, order) != COMPACT_CONTINUE ||
+	    compaction_deferred(zone))
+		return;
+
+	INIT_LIST_HEAD(&cc.freepages);
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	status = compact_zone(zone, &cc);
+
+	VM_BUG_ON(!list_empty(&cc.freepages));
+	VM_BUG_ON(!list_empty(&cc.migratepages));
+
+	if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0)) {
+		zone->compact_considered = 0;
+		zone->compact_defer_shift = 0;
+		count_vm_event(KCOMPACTD_SUCCESS);
+		if (zone->compact_ready_order < order)
+			zone->compact_ready_order = order;
+	} else if (status == COMPACT_COMPLETE)
+		defer_compaction(zone);
+}
+
+/* Serve the high-order request kswapd was woken for */
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	enum zone_type classzone_idx = pgdat->kcompactd_classzone_idx;
+	int zoneid;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		kcompactd_compact_zone(zone, order);
+
+		if (kthread_should_stop())
+			return;
+	}
+
+	/*
+	 * Forget the request, unless a larger or more constrained one
+	 * came in while we were busy.
+	 */
+	if (pgdat->kcompactd_max_order <= order)
+		pgdat->kcompactd_max_order = 0;
+	if (pgdat->kcompactd_classzone_idx >= classzone_idx)
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+}
+
+/* Compact the zones whose free memory became too fragmented */
+static void kcompactd_proactive(pg_data_t *pgdat)
+{
+	int order = kcompactd_proactive_order;
+	bool woken = false;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (fragmentation_index(zone, order) <=
+		    (int)kcompactd_proactive_threshold)
+			continue;
+
+		if (!woken) {
+			count_vm_event(KCOMPACTD_WAKE);
+			woken = true;
+		}
+		kcompactd_compact_zone(zone, order);
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+static void kcompactd_try_to_sleep(pg_data_t *pgdat)
+{
+	long timeout = MAX_SCHEDULE_TIMEOUT;
+	DEFINE_WAIT(wait);
+
+	if (kcompactd_interval_msecs)
+		timeout = msecs_to_jiffies(kcompactd_interval_msecs);
+
+	prepare_to_wait(&pgdat->kcompactd_wait, &wait, TASK_INTERRUPTIBLE);
+	if (!kcompactd_work_requested(pgdat))
+		schedule_timeout(timeout);
+	finish_wait(&pgdat->kcompactd_wait, &wait);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+
+	while (!kthread_should_stop()) {
+		kcompactd_try_to_sleep(pgdat);
+
+		if (try_to_freeze() || kthread_should_stop())
+			continue;
+
+		if (pgdat->kcompactd_max_order > 0)
+			kcompactd_do_work(pgdat);
+		else if (kcompactd_interval_msecs)
+			kcompactd_proactive(pgdat);
+	}
+
+	return 0;
+}
+
+/*
+ * Ask kcompactd to make blocks of @order available in the zones up to
+ * @classzone_idx.  Called by kswapd once it has reclaimed for a high-order
+ * wakeup.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order || !pgdat->kcompactd)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.  Caller must
+ * hold lock_memory_hotplug().
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+#ifdef CONFIG_SYSFS
+static void kcompactd_wake_all(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		wake_up_interruptible(&NODE_DATA(nid)->kcompactd_wait);
+}
+
+static ssize_t proactive_interval_ms_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", kcompactd_interval_msecs);
+}
+
+static ssize_t proactive_interval_ms_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	kcompactd_interval_msecs = msecs;
+	/* Let sleeping threads pick up the new interval */
+	kcompactd_wake_all();
+
+	return count;
+}
+static struct kobj_attribute proactive_interval_ms_attr =
+	__ATTR(proactive_interval_ms, 0644, proactive_interval_ms_show,
+	       proactive_interval_ms_store);
+
+static ssize_t proactive_order_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", kcompactd_proactive_order);
+}
+
+static ssize_t proactive_order_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long order;
+	int err;
+
+	err = strict_strtoul(buf, 10, &order);
+	if (err || order < 1 || order >= MAX_ORDER)
+		return -EINVAL;
+
+	kcompactd_proactive_order = order;
+
+	return count;
+}
+static struct kobj_attribute proactive_order_attr =
+	__ATTR(proactive_order, 0644, proactive_order_show,
+	       proactive_order_store);
+
+static ssize_t proactive_threshold_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", kcompactd_proactive_threshold);
+}
+
+static ssize_t proactive_threshold_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long threshold;
+	int err;
+
+	err = strict_strtoul(buf, 10, &threshold);
+	if (err || threshold > 1000)
+		return -EINVAL;
+
+	kcompactd_proactive_threshold = threshold;
+
+	return count;
+}
+static struct kobj_attribute proactive_threshold_attr =
+	__ATTR(proactive_threshold, 0644, proactive_threshold_show,
+	       proactive_threshold_store);
+
+static struct attribute *compaction_attrs[] = {
+	&proactive_interval_ms_attr.attr,
+	&proactive_order_attr.attr,
+	&proactive_threshold_attr.attr,
+	NULL,
+};
+
+static struct attribute_group compaction_attr_group = {
+	.attrs = compaction_attrs,
+	.name = "compaction",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &compaction_attr_group))
+		printk(KERN_ERR "kcompactd: register sysfs failed\n");
+#endif
+	return 0;
+}
+module_init(kcompactd_init)
@@ -129,6 +129,10 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @checksummed: @oldchecksum is valid
+ * @unchanged: the page was not written to since @oldchecksum was taken
+ * @age: scans since the checksum of the page last changed, for smart scan
+ * @remaining_skips: scans smart scan still leaves the page out of
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -139,6 +143,10 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	unsigned int checksummed:1;
+	unsigned int unchanged:1;
+	unsigned char age;
+	unsigned char remaining_skips;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -189,6 +197,21 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * Skip the checksum of pages that were not written to since the last
+ * scan, and back off from pages that stay the same without merging.
+ */
+static bool ksm_smart_scan = true;
+
+/* Upper bound of the number of scans a page is skipped for in a row */
+#define KSM_MAX_SKIP	8
+
+/* The number of pages whose checksum smart scan could reuse */
+static unsigned long ksm_checksums_skipped;
+
+/* The number of pages left out of a scan by smart scan */
+static unsigned long ksm_pages_skipped;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -1157,6 +1180,8 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+
+	rmap_item->mm->ksm_pages_merged++;
 }
 
 /*
@@ -1202,9 +1227,16 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
-	if (rmap_item->oldchecksum != checksum) {
+	if (rmap_item->checksummed && rmap_item->unchanged) {
+		checksum = rmap_item->oldchecksum;
+		ksm_checksums_skipped++;
+	} else
+		checksum = calc_checksum(page);
+	if (!rmap_item->checksummed || rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
+		rmap_item->checksummed = 1;
+		rmap_item->age = 0;
+		rmap_item->remaining_skips = 0;
 		return;
 	}
 
@@ -1272,6 +1304,80 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Transfer the dirty bit of the pte mapping @page at @addr to the page,
+ * and return whether it was set: whether the page may have been written
+ * to since the last call.  This is only a hint for smart scan, which never
+ * merges without comparing the pages; pages that are mapped more than
+ * once, or by a huge pmd, are always reported as written to.
+ */
+static bool page_test_clear_dirty(struct vm_area_struct *vma,
+				  struct page *page, unsigned long addr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pte_t *ptep;
+	spinlock_t *ptl;
+	bool dirty;
+
+	if (PageTransCompound(page) || page_mapcount(page) != 1)
+		return true;
+
+	ptep = page_check_address(page, mm, addr, &ptl, 0);
+	if (!ptep)
+		return true;
+
+	dirty = pte_dirty(*ptep);
+	if (dirty) {
+		pte_t entry;
+
+		flush_cache_page(vma, addr, page_to_pfn(page));
+		entry = ptep_clear_flush(vma, addr, ptep);
+		set_page_dirty(page);
+		entry = pte_mkclean(entry);
+		set_pte_at_notify(mm, addr, ptep, entry);
+	}
+	pte_unmap_unlock(ptep, ptl);
+	return dirty;
+}
+
+/*
+ * A page that has kept its content for a few scans without finding a match
+ * is unlikely to find one in the next scan either: smart scan leaves it out
+ * of 1, 2, 4 and then KSM_MAX_SKIP scans in between those it takes part
+ * in, dropping it from the unstable tree as if it were volatile.  Merged
+ * pages are never skipped, and a change of content starts over at age 0.
+ */
+static bool ksm_skip_rmap_item(struct page *page, struct rmap_item *rmap_item)
+{
+	unsigned int age;
+
+	if (!ksm_smart_scan || PageKsm(page))
+		return false;
+
+	age = rmap_item->age;
+	if (age < 255)
+		rmap_item->age++;
+	if (age < 3)
+		return false;
+
+	if (!rmap_item->remaining_skips) {
+		if (age <= 3)
+			rmap_item->remaining_skips = 1;
+		else if (age <= 5)
+			rmap_item->remaining_skips = 2;
+		else if (age <= 8)
+			rmap_item->remaining_skips = 4;
+		else
+			rmap_item->remaining_skips = KSM_MAX_SKIP;
+		return false;
+	}
+
+	rmap_item->remaining_skips--;
+	remove_rmap_item_from_tree(rmap_item);
+	ksm_pages_skipped++;
+	return true;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1346,6 +1452,17 @@ next_mm:
 				if (rmap_item) {
 					ksm_scan.rmap_list =
 							&rmap_item->rmap_list;
+					if (ksm_skip_rmap_item(*page,
+							       rmap_item)) {
+						put_page(*page);
+						ksm_scan.address += PAGE_SIZE;
+						cond_resched();
+						continue;
+					}
+					rmap_item->unchanged = ksm_smart_scan &&
+						!PageKsm(*page) &&
+						!page_test_clear_dirty(vma,
+							*page, ksm_scan.address);
 					ksm_scan.address += PAGE_SIZE;
 				} else
 					put_page(*page);
@@ -1411,15 +1528,19 @@ static void ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	u64 start;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
+		start = local_clock();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		rmap_item->mm->ksm_pages_scanned++;
+		rmap_item->mm->ksm_scan_time += local_clock() - start;
 	}
 }
 
@@ -1564,6 +1685,20 @@ void __ksm_exit(struct mm_struct *mm)
 	}
 }
 
+/*
+ * ksmd updates the statistics of an mm under ksm_thread_mutex, which also
+ * keeps the 64-bit scan time from being read half updated.
+ */
+void ksm_mm_stat(struct mm_struct *mm, unsigned long *scanned,
+		 unsigned long *merged, u64 *time)
+{
+	mutex_lock(&ksm_thread_mutex);
+	*scanned = mm->ksm_pages_scanned;
+	*merged = mm->ksm_pages_merged;
+	*time = mm->ksm_scan_time;
+	mutex_unlock(&ksm_thread_mutex);
+}
+
 struct page *ksm_does_need_to_copy(struct page *page,
 			struct vm_area_struct *vma, unsigned long address)
 {
@@ -1966,6 +2101,43 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t smart_scan_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_smart_scan);
+}
+
+static ssize_t smart_scan_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	int err;
+	unsigned long flags;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_smart_scan = flags;
+
+	return count;
+}
+KSM_ATTR(smart_scan);
+
+static ssize_t checksums_skipped_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_checksums_skipped);
+}
+KSM_ATTR_RO(checksums_skipped);
+
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1975,6 +2147,9 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&smart_scan_attr.attr,
+	&checksums_skipped_attr.attr,
+	&pages_skipped_attr.attr,
 	NULL,
 };
 
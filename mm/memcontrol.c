@@ -59,6 +59,10 @@ struct cgroup_subsys mem_cgroup_subsys __read_mostly;
 #define MEM_CGROUP_RECLAIM_RETRIES	5
 struct mem_cgroup *root_mem_cgroup __read_mostly;
 
+#define MEM_CGROUP_RECLAIM_PRIO_MAX	4
+/* # of cgroups with a non-zero reclaim_priority */
+static atomic_t nr_reclaim_prio_memcgs = ATOMIC_INIT(0);
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 /* Turned on only when memory cgroup is enabled && really_do_swap_account = 1 */
 int do_swap_account __read_mostly;
@@ -97,6 +101,9 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_COUNT,	/* # of pages paged in/out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_PGSCAN,	/* # of pages scanned by memcg reclaim */
+	MEM_CGROUP_EVENTS_PGSTEAL,	/* # of pages freed by memcg reclaim */
+	MEM_CGROUP_EVENTS_PGSTEAL_PRIO,	/* # of those freed by priority reclaim */
 	MEM_CGROUP_EVENTS_NSTATS,
 };
 /*
@@ -250,6 +257,11 @@ struct mem_cgroup {
 	atomic_t	refcnt;
 
 	unsigned int	swappiness;
+	/*
+	 * Global reclaim takes pages from cgroups with a non-zero
+	 * reclaim_priority before it scans the zone LRU, highest first.
+	 */
+	int		reclaim_priority;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -3739,6 +3751,54 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return nr_reclaimed;
 }
 
+/*
+ * Called from global reclaim before the zone LRU is scanned: visit the
+ * cgroups with a reclaim priority, highest priority first, until a batch
+ * of pages has been freed.  A cgroup is scanned as if reclaim were
+ * reclaim_priority levels more desperate than it is, so that background
+ * applications are aged, and depending on their swappiness swapped out,
+ * well ahead of the rest of the system.
+ */
+unsigned long mem_cgroup_priority_reclaim(struct zone *zone, int priority,
+					  gfp_t gfp_mask,
+					  unsigned long *total_scanned)
+{
+	unsigned long nr_reclaimed = 0;
+	unsigned long reclaimed, nr_scanned;
+	struct mem_cgroup *iter;
+	int level;
+
+	if (!atomic_read(&nr_reclaim_prio_memcgs))
+		return 0;
+
+	for (level = MEM_CGROUP_RECLAIM_PRIO_MAX; level > 0; level--) {
+		if (nr_reclaimed >= SWAP_CLUSTER_MAX)
+			break;
+		for_each_mem_cgroup_tree_cond(iter, NULL,
+				nr_reclaimed < SWAP_CLUSTER_MAX) {
+			if (iter->reclaim_priority != level)
+				continue;
+			nr_scanned = 0;
+			reclaimed = mem_cgroup_shrink_zone(iter, gfp_mask,
+						get_swappiness(iter), zone,
+						max(priority - level, 0),
+						&nr_scanned);
+			this_cpu_add(iter->stat->events[MEM_CGROUP_EVENTS_PGSTEAL_PRIO],
+				     reclaimed);
+			nr_reclaimed += reclaimed;
+			*total_scanned += nr_scanned;
+		}
+	}
+	return nr_reclaimed;
+}
+
+void mem_cgroup_count_reclaim(struct mem_cgroup *mem, unsigned long scanned,
+			      unsigned long reclaimed)
+{
+	this_cpu_add(mem->stat->events[MEM_CGROUP_EVENTS_PGSCAN], scanned);
+	this_cpu_add(mem->stat->events[MEM_CGROUP_EVENTS_PGSTEAL], reclaimed);
+}
+
 /*
  * This routine traverse page_cgroup in given list and drop them all.
  * *And* this routine doesn't reclaim page itself, just removes page_cgroup.
@@ -4139,6 +4199,9 @@ enum {
 	MCS_SWAP,
 	MCS_PGFAULT,
 	MCS_PGMAJFAULT,
+	MCS_PGSCAN,
+	MCS_PGSTEAL,
+	MCS_PGSTEAL_PRIO,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -4163,6 +4226,9 @@ struct {
 	{"swap", "total_swap"},
 	{"pgfault", "total_pgfault"},
 	{"pgmajfault", "total_pgmajfault"},
+	{"pgscan", "total_pgscan"},
+	{"pgsteal", "total_pgsteal"},
+	{"pgsteal_priority", "total_pgsteal_priority"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -4195,6 +4261,12 @@ mem_cgroup_get_local_stat(struct mem_cgroup *mem, struct mcs_total_stat *s)
 	s->stat[MCS_PGFAULT] += val;
 	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_PGMAJFAULT);
 	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_PGSCAN);
+	s->stat[MCS_PGSCAN] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_PGSTEAL);
+	s->stat[MCS_PGSTEAL] += val;
+	val = mem_cgroup_read_events(mem, MEM_CGROUP_EVENTS_PGSTEAL_PRIO);
+	s->stat[MCS_PGSTEAL_PRIO] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON);
@@ -4366,6 +4438,34 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+static u64 mem_cgroup_reclaim_priority_read(struct cgroup *cgrp,
+					    struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->reclaim_priority;
+}
+
+static int mem_cgroup_reclaim_priority_write(struct cgroup *cgrp,
+					     struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	if (val > MEM_CGROUP_RECLAIM_PRIO_MAX)
+		return -EINVAL;
+
+	if (cgrp->parent == NULL)
+		return -EINVAL;
+
+	cgroup_lock();
+	if (!memcg->reclaim_priority && val)
+		atomic_inc(&nr_reclaim_prio_memcgs);
+	else if (memcg->reclaim_priority && !val)
+		atomic_dec(&nr_reclaim_prio_memcgs);
+	memcg->reclaim_priority = val;
+	cgroup_unlock();
+
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -4772,6 +4872,11 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "reclaim_priority",
+		.read_u64 = mem_cgroup_reclaim_priority_read,
+		.write_u64 = mem_cgroup_reclaim_priority_write,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -5050,8 +5155,12 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	mem->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&mem->oom_notify);
 
-	if (parent)
+	if (parent) {
 		mem->swappiness = get_swappiness(parent);
+		mem->reclaim_priority = parent->reclaim_priority;
+		if (mem->reclaim_priority)
+			atomic_inc(&nr_reclaim_prio_memcgs);
+	}
 	atomic_set(&mem->refcnt, 1);
 	mem->move_charge_at_immigrate = 0;
 	mutex_init(&mem->thresholds_lock);
@@ -5074,6 +5183,8 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	if (mem->reclaim_priority)
+		atomic_dec(&nr_reclaim_prio_memcgs);
 	mem_cgroup_put(mem);
 }
 
@@ -594,6 +594,36 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+#ifdef CONFIG_ZONE_LOCK_STAT
+/*
+ * Hold times of zone->lock, as taken by the buddy allocator paths below.
+ * The counters are only updated with the lock held.
+ */
+static inline u64 zone_lock_stat_begin(struct zone *zone)
+{
+	zone->lock_acquired++;
+	return local_clock();
+}
+
+static inline void zone_lock_stat_end(struct zone *zone, u64 start)
+{
+	u64 held = local_clock() - start;
+
+	zone->lock_hold_ns += held;
+	if (held > zone->lock_hold_max_ns)
+		zone->lock_hold_max_ns = held;
+}
+#else
+static inline u64 zone_lock_stat_begin(struct zone *zone)
+{
+	return 0;
+}
+
+static inline void zone_lock_stat_end(struct zone *zone, u64 start)
+{
+}
+#endif
+
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
@@ -611,8 +641,11 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int migratetype = 0;
 	int batch_free = 0;
 	int to_free = count;
+	u64 start;
 
+	__count_vm_event(PCP_DRAIN);
 	spin_lock(&zone->lock);
+	start = zone_lock_stat_begin(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -648,18 +681,23 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	zone_lock_stat_end(zone, start);
 	spin_unlock(&zone->lock);
 }
 
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
+	u64 start;
+
 	spin_lock(&zone->lock);
+	start = zone_lock_stat_begin(zone);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
 	__free_one_page(page, zone, order, migratetype);
 	__mod_zone_page_state(zone, NR_FREE_PAGES, 1 << order);
+	zone_lock_stat_end(zone, start);
 	spin_unlock(&zone->lock);
 }
 
@@ -1039,8 +1077,10 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			int migratetype, int cold)
 {
 	int i;
-	
+	u64 start;
+
 	spin_lock(&zone->lock);
+	start = zone_lock_stat_begin(zone);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype);
 		if (unlikely(page == NULL))
@@ -1063,10 +1103,53 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
+	zone_lock_stat_end(zone, start);
 	spin_unlock(&zone->lock);
 	return i;
 }
 
+/*
+ * The per-cpu lists are refilled and drained in batches, to amortise the
+ * zone->lock round-trips.  A CPU that refills several times in a row, or
+ * drains several times in a row, is in an allocation or a free burst: scale
+ * the batch up for as long as the burst lasts, up to 1 << PCP_FACTOR_MAX
+ * times pcp->batch.  A CPU that refills lists it has just drained is
+ * cycling pages through the buddy lists for nothing, so pcp->high is raised
+ * too, up to pcp->high_max.  decay_pcp_high() brings it back down over time.
+ */
+#define PCP_FACTOR_MAX	3
+
+static int nr_pcp_alloc(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int nr;
+
+	if (pcp->free_factor && pcp->high < pcp->high_max &&
+	    zone_page_state(zone, NR_FREE_PAGES) > low_wmark_pages(zone))
+		pcp->high = min(pcp->high + pcp->batch, pcp->high_max);
+
+	nr = pcp->batch << pcp->alloc_factor;
+	/* Don't overshoot high, the next free would drain it right back */
+	nr = max(min(nr, pcp->high - pcp->count), pcp->batch);
+
+	if (pcp->alloc_factor < PCP_FACTOR_MAX)
+		pcp->alloc_factor++;
+	pcp->free_factor >>= 1;
+	__count_vm_event(PCP_REFILL);
+	return nr;
+}
+
+static int nr_pcp_free(struct per_cpu_pages *pcp)
+{
+	int nr;
+
+	nr = min(pcp->batch << pcp->free_factor, pcp->count);
+
+	if (pcp->free_factor < PCP_FACTOR_MAX)
+		pcp->free_factor++;
+	pcp->alloc_factor >>= 1;
+	return nr;
+}
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -1092,6 +1175,36 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 }
 #endif
 
+/*
+ * Called from the vmstat counter updater: let an auto-tuned pcp->high
+ * sink back towards pcp->high_min once the burst that raised it is over,
+ * and give back the pages above the new high.  Straight to high_min when
+ * the zone is short of free pages.
+ *
+ * Must be called on the processor owning @pcp, or for an offline one.
+ */
+void decay_pcp_high(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	unsigned long flags;
+	int to_drain;
+
+	if (pcp->high <= pcp->high_min)
+		return;
+
+	local_irq_save(flags);
+	if (zone_page_state(zone, NR_FREE_PAGES) <= low_wmark_pages(zone))
+		pcp->high = pcp->high_min;
+	else
+		pcp->high = max(pcp->high - max((pcp->high - pcp->high_min) / 4,
+						pcp->batch), pcp->high_min);
+	to_drain = pcp->count - pcp->high;
+	if (to_drain > 0) {
+		free_pcppages_bulk(zone, to_drain, pcp);
+		pcp->count -= to_drain;
+	}
+	local_irq_restore(flags);
+}
+
 /*
  * Drain pages of the indicated processor.
  *
@@ -1216,8 +1329,10 @@ void free_hot_cold_page(struct page *page, int cold)
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
-		free_pcppages_bulk(zone, pcp->batch, pcp);
-		pcp->count -= pcp->batch;
+		int to_free = nr_pcp_free(pcp);
+
+		free_pcppages_bulk(zone, to_free, pcp);
+		pcp->count -= to_free;
 	}
 
 out:
@@ -1310,6 +1425,7 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	unsigned long flags;
 	struct page *page;
 	int cold = !!(gfp_flags & __GFP_COLD);
+	u64 start;
 
 again:
 	if (likely(order == 0)) {
@@ -1321,7 +1437,7 @@ again:
 		list = &pcp->lists[migratetype];
 		if (list_empty(list)) {
 			pcp->count += rmqueue_bulk(zone, 0,
-					pcp->batch, list,
+					nr_pcp_alloc(zone, pcp), list,
 					migratetype, cold);
 			if (unlikely(list_empty(list)))
 				goto failed;
@@ -1349,7 +1465,9 @@ again:
 			WARN_ON_ONCE(order > 1);
 		}
 		spin_lock_irqsave(&zone->lock, flags);
+		start = zone_lock_stat_begin(zone);
 		page = __rmqueue(zone, order, migratetype);
+		zone_lock_stat_end(zone, start);
 		spin_unlock(&zone->lock);
 		if (!page)
 			goto failed;
@@ -2355,6 +2473,8 @@ retry_cpuset:
 		page = __alloc_pages_slowpath(gfp_mask, order,
 				zonelist, high_zoneidx, nodemask,
 				preferred_zone, migratetype);
+	else if (order)
+		compaction_count_avoided(page_zone(page), order);
 
 	trace_mm_page_alloc(page, order, gfp_mask, migratetype);
 
@@ -3657,6 +3777,8 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
+	pcp->high_min = pcp->high;
+	pcp->high_max = pcp->high;
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -3676,6 +3798,39 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	/* An explicit high mark is not auto-tuned */
+	pcp->high_min = high;
+	pcp->high_max = high;
+	pcp->alloc_factor = 0;
+	pcp->free_factor = 0;
+}
+
+/*
+ * Let pcp->high grow up to four times its boot value under bursts, but
+ * never past 1/8th of the zone shared among all the CPUs.
+ */
+static void setup_pagelist_highmax(struct per_cpu_pageset *p,
+				struct zone *zone)
+{
+	struct per_cpu_pages *pcp = &p->pcp;
+	unsigned long high_max;
+
+	high_max = zone->present_pages / 8 / num_possible_cpus();
+	high_max = min_t(unsigned long, high_max, 4 * pcp->high_min);
+	pcp->high_max = max_t(unsigned long, high_max, pcp->high_min);
+}
+
+/*
+ * Auto-tune the high mark of a freshly set up pageset, unless the admin
+ * set it through vm.percpu_pagelist_fraction.
+ */
+static void setup_pagelist_high(struct per_cpu_pageset *p, struct zone *zone)
+{
+	if (percpu_pagelist_fraction)
+		setup_pagelist_highmark(p,
+			(zone->present_pages / percpu_pagelist_fraction));
+	else
+		setup_pagelist_highmax(p, zone);
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -3688,11 +3843,7 @@ static void setup_zone_pageset(struct zone *zone)
 		struct per_cpu_pageset *pcp = per_cpu_ptr(zone->pageset, cpu);
 
 		setup_pageset(pcp, zone_batchsize(zone));
-
-		if (percpu_pagelist_fraction)
-			setup_pagelist_highmark(pcp,
-				(zone->present_pages /
-					percpu_pagelist_fraction));
+		setup_pagelist_high(pcp, zone);
 	}
 }
 
@@ -3767,6 +3918,7 @@ static int __zone_pcp_update(void *data)
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		setup_pageset(pset, batch);
+		setup_pagelist_high(pset, zone);
 		local_irq_restore(flags);
 	}
 	return 0;
@@ -4374,6 +4526,10 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->kcompactd_max_order = 0;
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4435,6 +4591,7 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 		zone->reclaim_stat.recent_rotated[1] = 0;
 		zone->reclaim_stat.recent_scanned[0] = 0;
 		zone->reclaim_stat.recent_scanned[1] = 0;
+		atomic_long_set(&zone->inactive_age, 0);
 		zap_zone_vm_stats(zone);
 		zone->flags = 0;
 		if (!size)
@@ -17,6 +17,11 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/fcntl.h>
+#include <linux/capability.h>
+#include <linux/uaccess.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -177,7 +182,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		rcu_read_lock();
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
 		rcu_read_unlock();
-		if (page)
+		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
 		page = page_cache_alloc_readahead(mapping);
@@ -349,7 +354,7 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 	pgoff_t head;
 
 	rcu_read_lock();
-	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	head = page_cache_prev_hole(mapping, offset - 1, max);
 	rcu_read_unlock();
 
 	return offset - 1 - head;
@@ -428,7 +433,7 @@ ondemand_readahead(struct address_space *mapping,
 		pgoff_t start;
 
 		rcu_read_lock();
-		start = radix_tree_next_hole(&mapping->page_tree, offset+1,max);
+		start = page_cache_next_hole(mapping, offset+1,max);
 		rcu_read_unlock();
 
 		if (!start || start - offset > max)
@@ -562,3 +567,233 @@ page_cache_async_readahead(struct address_space *mapping,
 	ondemand_readahead(mapping, ra, filp, true, offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_TRACE
+/*
+ * Launch prefetching.
+ *
+ * ondemand_readahead() only learns the access pattern of one open file,
+ * so each cold start of an application faults in the same scattered pages
+ * of its code and data files one readaround window at a time.  Instead,
+ * a privileged process can have the pages of a file faulted in through
+ * mmap recorded (F_SET_RA_TRACE), save the trace (F_GET_RA_TRACE), and on
+ * the next launch have all of those pages read in as one asynchronous,
+ * plugged batch (F_RA_REPLAY) before the application gets to them.
+ *
+ * The trace is a bitmap of the pages of the file, hung off its mapping
+ * until the inode goes away.  It covers the file as it was when tracing
+ * first started, up to RA_TRACE_MAX_PAGES.
+ */
+#define RA_TRACE_MAX_PAGES	(1UL << 20)
+#define RA_TRACE_MAX_RANGES	(1U << 16)
+
+struct ra_trace {
+	unsigned long nr_pages;		/* pages covered by the bitmap */
+	bool recording;
+	unsigned long bitmap[0];
+};
+
+void __ra_trace_record(struct address_space *mapping, pgoff_t index)
+{
+	struct ra_trace *trace = ACCESS_ONCE(mapping->ra_trace);
+
+	if (trace->recording && index < trace->nr_pages &&
+	    !test_bit(index, trace->bitmap))
+		set_bit(index, trace->bitmap);
+}
+
+void ra_trace_free(struct address_space *mapping)
+{
+	struct ra_trace *trace = mapping->ra_trace;
+
+	if (!trace)
+		return;
+	mapping->ra_trace = NULL;
+	if (is_vmalloc_addr(trace))
+		vfree(trace);
+	else
+		kfree(trace);
+}
+
+static int ra_trace_set(struct address_space *mapping, unsigned long on)
+{
+	struct ra_trace *trace = ACCESS_ONCE(mapping->ra_trace);
+	unsigned long nr_pages;
+	size_t size;
+
+	if (!on) {
+		if (trace)
+			trace->recording = false;
+		return 0;
+	}
+
+	if (trace) {
+		/* Start over */
+		trace->recording = false;
+		bitmap_zero(trace->bitmap, trace->nr_pages);
+		trace->recording = true;
+		return 0;
+	}
+
+	nr_pages = DIV_ROUND_UP(i_size_read(mapping->host), PAGE_CACHE_SIZE);
+	if (!nr_pages)
+		return -EINVAL;
+	nr_pages = min(nr_pages, RA_TRACE_MAX_PAGES);
+
+	size = sizeof(*trace) + BITS_TO_LONGS(nr_pages) * sizeof(long);
+	if (size <= PAGE_SIZE)
+		trace = kzalloc(size, GFP_KERNEL);
+	else
+		trace = vzalloc(size);
+	if (!trace)
+		return -ENOMEM;
+	trace->nr_pages = nr_pages;
+	trace->recording = true;
+
+	/* Somebody else may have started tracing in the meantime */
+	if (cmpxchg(&mapping->ra_trace, NULL, trace) != NULL) {
+		if (is_vmalloc_addr(trace))
+			vfree(trace);
+		else
+			kfree(trace);
+	}
+	return 0;
+}
+
+/*
+ * Copy the ranges of pages recorded out to @utrace, as many as it has room
+ * for, and return the number of ranges there are in all.
+ */
+static long ra_trace_get(struct address_space *mapping,
+			 struct f_ra_trace __user *utrace)
+{
+	struct ra_trace *trace = ACCESS_ONCE(mapping->ra_trace);
+	unsigned long start, end;
+	u32 room, nr = 0;
+
+	if (!trace)
+		return -ENODATA;
+	if (get_user(room, &utrace->nr_ranges))
+		return -EFAULT;
+
+	start = find_first_bit(trace->bitmap, trace->nr_pages);
+	while (start < trace->nr_pages) {
+		end = find_next_zero_bit(trace->bitmap, trace->nr_pages, start);
+		if (nr < room) {
+			struct f_ra_range range = {
+				.start = start,
+				.nr_pages = end - start,
+			};
+
+			if (copy_to_user(&utrace->ranges[nr], &range,
+					 sizeof(range)))
+				return -EFAULT;
+		}
+		nr++;
+		start = find_next_bit(trace->bitmap, trace->nr_pages, end);
+	}
+
+	if (put_user(min(nr, room), &utrace->nr_ranges))
+		return -EFAULT;
+	return nr;
+}
+
+static void ra_trace_read(struct file *filp, u64 start, u64 nr_pages)
+{
+	struct address_space *mapping = filp->f_mapping;
+	loff_t isize = i_size_read(mapping->host);
+	pgoff_t end_index;
+
+	if (!isize || !nr_pages)
+		return;
+	end_index = (isize - 1) >> PAGE_CACHE_SHIFT;
+	if (start > end_index)
+		return;
+	nr_pages = min_t(u64, nr_pages, end_index - start + 1);
+	force_page_cache_readahead(mapping, filp, start, nr_pages);
+}
+
+/*
+ * Read in the pages of the ranges in @utrace, or of the trace recorded on
+ * the file itself if @utrace is NULL, under a single plug.  The reads are
+ * only submitted, not waited for.
+ */
+static long ra_trace_replay(struct file *filp, struct f_ra_trace __user *utrace)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct blk_plug plug;
+	long ret = 0;
+	u32 i, nr;
+
+	if (!(filp->f_mode & FMODE_READ))
+		return -EBADF;
+	if (!mapping->a_ops->readpage && !mapping->a_ops->readpages)
+		return -EINVAL;
+
+	if (!utrace) {
+		struct ra_trace *trace = ACCESS_ONCE(mapping->ra_trace);
+		unsigned long start, end;
+
+		if (!trace)
+			return -ENODATA;
+		blk_start_plug(&plug);
+		start = find_first_bit(trace->bitmap, trace->nr_pages);
+		while (start < trace->nr_pages) {
+			end = find_next_zero_bit(trace->bitmap,
+						 trace->nr_pages, start);
+			ra_trace_read(filp, start, end - start);
+			if (fatal_signal_pending(current)) {
+				ret = -EINTR;
+				break;
+			}
+			start = find_next_bit(trace->bitmap,
+					      trace->nr_pages, end);
+		}
+		blk_finish_plug(&plug);
+		return ret;
+	}
+
+	if (get_user(nr, &utrace->nr_ranges) || get_user(i, &utrace->flags))
+		return -EFAULT;
+	if (i || nr > RA_TRACE_MAX_RANGES)
+		return -EINVAL;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++) {
+		struct f_ra_range range;
+
+		if (copy_from_user(&range, &utrace->ranges[i],
+				   sizeof(range))) {
+			ret = -EFAULT;
+			break;
+		}
+		ra_trace_read(filp, range.start, range.nr_pages);
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+	}
+	blk_finish_plug(&plug);
+	return ret;
+}
+
+long ra_trace_fcntl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct address_space *mapping = filp->f_mapping;
+
+	switch (cmd) {
+	case F_SET_RA_TRACE:
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+		return ra_trace_set(mapping, arg);
+	case F_GET_RA_TRACE:
+		/* The trace tells how other processes use the file */
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+		return ra_trace_get(mapping, (struct f_ra_trace __user *)arg);
+	case F_RA_REPLAY:
+		return ra_trace_replay(filp, (struct f_ra_trace __user *)arg);
+	}
+	return -EINVAL;
+}
+#endif /* CONFIG_READAHEAD_TRACE */
@@ -30,6 +30,10 @@
 
 #include <trace/events/kmem.h>
 
+#ifdef CONFIG_HAVE_LOCAL_LLSC
+#include <asm/llsc.h>
+#endif
+
 /*
  * Lock order:
  *   1. slab_lock(page)
@@ -1573,6 +1577,43 @@ static void unfreeze_slab(struct kmem_cache *s, struct page *page, int tail)
 	}
 }
 
+/*
+ * Per cpu partial slabs.
+ *
+ * A full slab that gets an object freed is not put back onto the node's
+ * partial list, but kept frozen on a short list of the freeing cpu, from
+ * which that cpu takes its next cpu slab.  Neither takes the list_lock,
+ * which is only taken once s->cpu_partial slabs have piled up, to move
+ * them over to the node lists all at once.
+ *
+ * Interrupts must be disabled.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page;
+
+	while ((page = c->partial)) {
+		c->partial = page->next;
+		slab_lock(page);
+		unfreeze_slab(s, page, 1);
+	}
+	c->nr_partial = 0;
+}
+
+static void put_cpu_partial(struct kmem_cache *s, struct page *page)
+{
+	struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+
+	if (c->nr_partial >= s->cpu_partial) {
+		unfreeze_partials(s, c);
+		stat(s, CPU_PARTIAL_DRAIN);
+	}
+	page->next = c->partial;
+	c->partial = page;
+	c->nr_partial++;
+	stat(s, CPU_PARTIAL_FREE);
+}
+
 #ifdef CONFIG_PREEMPT
 /*
  * Calculate the next globally unique transaction for disambiguiation
@@ -1690,8 +1731,11 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
-		flush_slab(s, c);
+	if (likely(c)) {
+		if (c->page)
+			flush_slab(s, c);
+		unfreeze_partials(s, c);
+	}
 }
 
 static void flush_cpu_slab(void *d)
@@ -1857,6 +1901,18 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
+	page = c->partial;
+	if (page && (node == NUMA_NO_NODE || page_to_nid(page) == node)) {
+		/* Already frozen, and has free objects */
+		c->partial = page->next;
+		c->nr_partial--;
+		stat(s, CPU_PARTIAL_ALLOC);
+		slab_lock(page);
+		c->node = page_to_nid(page);
+		c->page = page;
+		goto load_freelist;
+	}
+
 	page = get_partial(s, gfpflags, node);
 	if (page) {
 		stat(s, ALLOC_FROM_PARTIAL);
@@ -1913,6 +1969,43 @@ debug:
  *
  * Otherwise we can simply pick the next object from the lockless free list.
  */
+#if defined(ARCH_HAVE_LLSC_FREELIST) && !defined(CONFIG_NUMA)
+/*
+ * Without this_cpu_cmpxchg_double() the tid based fastpaths below fall
+ * back to disabling interrupts around every operation.  Where the arch
+ * has a load-linked/store-conditional pair that an interrupt breaks,
+ * the cpu freelist can instead be updated with single word atomics:
+ * a racing interrupt simply makes the sequence start over.
+ */
+#define SLUB_LLSC_FASTPATH
+
+static __always_inline void *slab_alloc(struct kmem_cache *s,
+		gfp_t gfpflags, int node, unsigned long addr)
+{
+	void **object;
+	struct kmem_cache_cpu *c;
+
+	if (slab_pre_alloc_hook(s, gfpflags))
+		return NULL;
+
+	preempt_disable();
+	c = __this_cpu_ptr(s->cpu_slab);
+	object = llsc_freelist_pop(&c->freelist, s->offset);
+	preempt_enable();
+
+	if (unlikely(!object))
+		object = __slab_alloc(s, gfpflags, node, addr, c);
+	else
+		stat(s, ALLOC_FASTPATH);
+
+	if (unlikely(gfpflags & __GFP_ZERO) && object)
+		memset(object, 0, s->objsize);
+
+	slab_post_alloc_hook(s, gfpflags, object);
+
+	return object;
+}
+#else
 static __always_inline void *slab_alloc(struct kmem_cache *s,
 		gfp_t gfpflags, int node, unsigned long addr)
 {
@@ -1978,6 +2071,7 @@ redo:
 
 	return object;
 }
+#endif /* SLUB_LLSC_FASTPATH */
 
 void *kmem_cache_alloc(struct kmem_cache *s, gfp_t gfpflags)
 {
@@ -2074,6 +2168,13 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 	 * then add it.
 	 */
 	if (unlikely(!prior)) {
+		if (s->cpu_partial && !kmem_cache_debug(s)) {
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			put_cpu_partial(s, page);
+			local_irq_restore(flags);
+			return;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
@@ -2108,6 +2209,26 @@ slab_empty:
  * If fastpath is not possible then fall back to __slab_free where we deal
  * with all sorts of special processing.
  */
+#ifdef SLUB_LLSC_FASTPATH
+static __always_inline void slab_free(struct kmem_cache *s,
+			struct page *page, void *x, unsigned long addr)
+{
+	struct kmem_cache_cpu *c;
+	int done;
+
+	slab_free_hook(s, x);
+
+	preempt_disable();
+	c = __this_cpu_ptr(s->cpu_slab);
+	done = llsc_freelist_push(&c->freelist, &c->page, page, x, s->offset);
+	preempt_enable();
+
+	if (likely(done))
+		stat(s, FREE_FASTPATH);
+	else
+		__slab_free(s, page, x, addr);
+}
+#else
 static __always_inline void slab_free(struct kmem_cache *s,
 			struct page *page, void *x, unsigned long addr)
 {
@@ -2146,6 +2267,7 @@ redo:
 		__slab_free(s, page, x, addr);
 
 }
+#endif /* SLUB_LLSC_FASTPATH */
 
 void kmem_cache_free(struct kmem_cache *s, void *x)
 {
@@ -2610,6 +2732,24 @@ static int kmem_cache_open(struct kmem_cache *s,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * The per cpu partial lists cut list_lock round-trips, but they
+	 * hold on to slabs that other cpus could allocate from, more so
+	 * for the big objects.  Debugging needs every slab on the node
+	 * lists.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 6;
+	else
+		s->cpu_partial = 8;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -4157,6 +4297,31 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs && kmem_cache_debug(s))
+		return -EINVAL;
+	if (slabs > INT_MAX)
+		return -ERANGE;
+
+	s->cpu_partial = slabs;
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -4503,6 +4668,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4511,6 +4679,7 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -4560,6 +4729,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -54,6 +54,40 @@ static struct {
 	unsigned long find_total;
 } swap_cache_info;
 
+/* Readahead pages hit since the last cluster readahead */
+static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* The PTEs are copied to the stack, bound the window accordingly */
+#ifdef CONFIG_64BIT
+#define SWAP_RA_ORDER_CEILING	5
+#else
+#define SWAP_RA_ORDER_CEILING	3
+#endif
+#define SWAP_RA_PTE_MAX		(1 << SWAP_RA_ORDER_CEILING)
+
+static void swap_ra_hit(struct vm_area_struct *vma)
+{
+	unsigned long ra_val = ACCESS_ONCE(vma->swap_readahead_info);
+	unsigned long hits = SWAP_RA_HITS(ra_val);
+
+	if (hits < SWAP_RA_HITS_MAX)
+		vma->swap_readahead_info = ra_val + 1;
+}
+
 void show_swap_cache_info(void)
 {
 	printk("%lu pages in swap cache\n", total_swapcache_pages);
@@ -260,14 +294,23 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma && swap_use_vma_readahead())
+				swap_ra_hit(vma);
+			else
+				atomic_inc(&swapin_readahead_hits);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -279,12 +322,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -335,6 +380,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -352,6 +398,92 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_allocated);
+}
+
+/*
+ * Queue readahead of @entry.  A page that was newly brought in is marked
+ * PageReadahead, so that lookup_swap_cache() can tell when readahead was
+ * worth it.
+ */
+static void swap_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			       struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	bool page_allocated;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_allocated);
+	if (!page)
+		return;
+	if (page_allocated) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+}
+
+/*
+ * Size the next readahead window from the number of readahead pages that
+ * were hit since the last one: roughly twice the hits, rounded up to a
+ * power of two and capped at @max_pages.  Without hits, only sequential
+ * faults keep a window of two pages, and the window is never more than
+ * halved at a time.
+ */
+static unsigned int __swapin_nr_pages(unsigned long prev_offset,
+				      unsigned long offset, int hits,
+				      int max_pages, int prev_win)
+{
+	unsigned int pages, last_ra;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		if (offset != prev_offset + 1 && offset != prev_offset - 1)
+			pages = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	last_ra = prev_win / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+
+	return pages;
+}
+
+static unsigned int swapin_nr_pages(unsigned long offset)
+{
+	static unsigned long prev_offset;
+	static atomic_t last_readahead_pages;
+	unsigned int hits, pages, max_pages;
+
+	max_pages = 1 << ACCESS_ONCE(page_cluster);
+	if (max_pages <= 1)
+		return 1;
+
+	hits = atomic_xchg(&swapin_readahead_hits, 0);
+	pages = __swapin_nr_pages(prev_offset, offset, hits, max_pages,
+				  atomic_read(&last_readahead_pages));
+	if (!hits)
+		prev_offset = offset;
+	atomic_set(&last_readahead_pages, pages);
+
+	return pages;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -362,9 +494,11 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * entries in the swap area. This method is chosen because it doesn't cost
+ * us any seek time.  We also make sure to queue the 'original' request
+ * together with the readahead ones...  The block is at most
+ * (1 << page_cluster) entries, and shrinks while the pages read ahead
+ * are not being used.
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -375,9 +509,9 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	int nr_pages;
-	struct page *page;
 	unsigned long offset;
 	unsigned long end_offset;
+	unsigned long target = swp_offset(entry);
 
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
@@ -386,15 +520,158 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 * more likely that neighbouring swap pages came from the same node:
 	 * so use the same "addr" to choose the same node for each swap read.
 	 */
-	nr_pages = valid_swaphandles(entry, &offset);
+	nr_pages = valid_swaphandles(entry, &offset,
+				     ilog2(swapin_nr_pages(target)));
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		if (offset == target)
+			continue;
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
-			break;
-		page_cache_release(page);
+		swap_readahead_one(swp_entry(swp_type(entry), offset),
+				   gfp_mask, vma, addr);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/**
+ * swap_vma_readahead - swap in pages in hope we need them soon
+ * @fentry: swap entry of the faulting page
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the fault is in
+ * @addr: faulting address
+ * @pmd: page middle directory entry mapping @addr
+ *
+ * Returns the struct page for @fentry, after queueing swapin of the swap
+ * entries mapped next to it in @vma.
+ *
+ * Where pages ended up on the swap device says little about whether they
+ * will be needed together: on a busy system, the slots around an entry
+ * hold pages of other VMAs and other processes.  Neighbouring virtual
+ * addresses of the faulting VMA are a much better guess, so read the swap
+ * entries found in the page table around the fault instead.
+ *
+ * The readahead window is kept per VMA, in vma->swap_readahead_info,
+ * together with the last fault address and the number of readahead pages
+ * hit since.  The window follows the direction of sequential faults and
+ * is centred on the fault otherwise; it never leaves the VMA or the page
+ * table of the fault.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+				struct vm_area_struct *vma, unsigned long addr,
+				pmd_t *pmd)
+{
+	pte_t ptes[SWAP_RA_PTE_MAX];
+	unsigned long ra_val, fpfn, pfn, start, end, lpfn, rpfn;
+	unsigned int max_win, win, hits, prev_win, left;
+	unsigned int i, nr_pte;
+	pte_t *pte;
+
+	max_win = 1 << min_t(unsigned int, ACCESS_ONCE(page_cluster),
+			     SWAP_RA_ORDER_CEILING);
+	if (max_win == 1)
+		goto skip;
+
+	fpfn = PFN_DOWN(addr);
+	ra_val = ACCESS_ONCE(vma->swap_readahead_info);
+	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	prev_win = SWAP_RA_WIN(ra_val);
+	hits = SWAP_RA_HITS(ra_val);
+	win = __swapin_nr_pages(pfn, fpfn, hits, max_win, prev_win);
+	vma->swap_readahead_info = SWAP_RA_VAL(addr, win, 0);
+	if (win == 1)
+		goto skip;
+
+	if (fpfn == pfn + 1) {
+		lpfn = fpfn;
+		rpfn = fpfn + win;
+	} else if (pfn == fpfn + 1) {
+		lpfn = fpfn - win + 1;
+		rpfn = fpfn + 1;
+	} else {
+		left = (win - 1) / 2;
+		lpfn = fpfn - left;
+		rpfn = fpfn + win - left;
+	}
+	start = max3(lpfn, PFN_DOWN(vma->vm_start),
+		     PFN_DOWN(addr & PMD_MASK));
+	end = min3(rpfn, PFN_DOWN(vma->vm_end),
+		   PFN_DOWN((addr & PMD_MASK) + PMD_SIZE));
+	if (end <= start)
+		goto skip;
+	nr_pte = end - start;
+
+	/* Copy the PTEs: swapping them in may sleep */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < nr_pte; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0; i < nr_pte; i++) {
+		swp_entry_t entry;
+
+		if (start + i == fpfn)
+			continue;
+		if (pte_none(ptes[i]) || pte_present(ptes[i]) ||
+		    pte_file(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		swap_readahead_one(entry, gfp_mask, vma,
+				   (start + i) << PAGE_SHIFT);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
+
+bool swap_vma_readahead_enabled __read_mostly = true;
+
+#ifdef CONFIG_SYSFS
+static ssize_t vma_ra_enabled_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", swap_vma_readahead_enabled ? "true" : "false");
+}
+
+static ssize_t vma_ra_enabled_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	if (!strncmp(buf, "true", 4) || !strncmp(buf, "1", 1))
+		swap_vma_readahead_enabled = true;
+	else if (!strncmp(buf, "false", 5) || !strncmp(buf, "0", 1))
+		swap_vma_readahead_enabled = false;
+	else
+		return -EINVAL;
+
+	return count;
+}
+
+static struct kobj_attribute vma_ra_enabled_attr =
+	__ATTR(vma_ra_enabled, 0644, vma_ra_enabled_show,
+	       vma_ra_enabled_store);
+
+static struct attribute *swap_attrs[] = {
+	&vma_ra_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_attr_group = {
+	.attrs = swap_attrs,
+	.name = "swap",
+};
+
+static int __init swap_init_sysfs(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &swap_attr_group);
+	if (err)
+		printk(KERN_ERR "failed to register swap group\n");
+	return 0;
+}
+subsys_initcall(swap_init_sysfs);
+#endif /* CONFIG_SYSFS */
@@ -253,6 +253,8 @@ struct vmap_area {
 	unsigned long va_start;
 	unsigned long va_end;
 	unsigned long flags;
+	unsigned long subtree_max_gap;	/* largest gap below an area in
+					   the subtree rooted here */
 	struct rb_node rb_node;		/* address sorted rbtree */
 	struct list_head list;		/* address sorted list */
 	struct list_head purge_list;	/* "lazy purge" list */
@@ -264,14 +266,47 @@ static DEFINE_SPINLOCK(vmap_area_lock);
 static LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 
-/* The vmap cache globals are protected by vmap_area_lock */
-static struct rb_node *free_vmap_cache;
-static unsigned long cached_hole_size;
-static unsigned long cached_vstart;
-static unsigned long cached_align;
-
 static unsigned long vmap_area_pcpu_hole;
 
+/*
+ * The rbtree of vmap areas is augmented with the largest free gap found in
+ * each subtree, the gap of an area being the unused address space between
+ * it and the next lower area.  This lets alloc_vmap_area() find the lowest
+ * hole that fits in O(log n), instead of walking the areas one by one.
+ */
+static unsigned long va_gap_below(struct vmap_area *va)
+{
+	struct vmap_area *prev;
+
+	if (va->list.prev == &vmap_area_list)
+		return va->va_start;
+
+	prev = list_entry(va->list.prev, struct vmap_area, list);
+	return va->va_start - prev->va_end;
+}
+
+static unsigned long va_subtree_max_gap(struct rb_node *n)
+{
+	return n ? rb_entry(n, struct vmap_area, rb_node)->subtree_max_gap : 0;
+}
+
+static void vmap_area_augment_cb(struct rb_node *node, void *unused)
+{
+	struct vmap_area *va = rb_entry(node, struct vmap_area, rb_node);
+	unsigned long max_gap = va_gap_below(va);
+
+	max_gap = max(max_gap, va_subtree_max_gap(node->rb_left));
+	max_gap = max(max_gap, va_subtree_max_gap(node->rb_right));
+	va->subtree_max_gap = max_gap;
+}
+
+/* The gap below @node changed: update the subtree maxima up to the root */
+static void vmap_area_augment_path(struct rb_node *node)
+{
+	for (; node; node = rb_parent(node))
+		vmap_area_augment_cb(node, NULL);
+}
+
 static struct vmap_area *__find_vmap_area(unsigned long addr)
 {
 	struct rb_node *n = vmap_area_root.rb_node;
@@ -321,6 +356,76 @@ static void __insert_vmap_area(struct vmap_area *va)
 		list_add_rcu(&va->list, &prev->list);
 	} else
 		list_add_rcu(&va->list, &vmap_area_list);
+
+	rb_augment_insert(&va->rb_node, vmap_area_augment_cb, NULL);
+	/* va took a bite out of the gap below the next area */
+	vmap_area_augment_path(rb_next(&va->rb_node));
+}
+
+/*
+ * Return the lowest address at which @size bytes aligned to @align fit
+ * between the areas, within @vstart and @vend; or @vend if they don't.
+ * Caller must hold vmap_area_lock.
+ */
+static unsigned long find_vmap_lowest_match(unsigned long size,
+				unsigned long align,
+				unsigned long vstart, unsigned long vend)
+{
+	struct rb_node *n = vmap_area_root.rb_node;
+	struct vmap_area *va;
+	unsigned long addr, gap_start;
+
+	if (!n || va_subtree_max_gap(n) < size)
+		goto check_highest;
+
+	while (true) {
+		va = rb_entry(n, struct vmap_area, rb_node);
+
+		/* Visit the lower areas first, if their gaps look promising */
+		if (va->va_start > vstart &&
+		    va_subtree_max_gap(n->rb_left) >= size) {
+			n = n->rb_left;
+			continue;
+		}
+check_current:
+		gap_start = va->va_start - va_gap_below(va);
+		if (gap_start >= vend)
+			return vend;
+		addr = ALIGN(max(gap_start, vstart), align);
+		if (addr >= gap_start && addr + size > addr &&
+		    addr + size <= va->va_start && addr + size <= vend)
+			return addr;
+
+		/* Then the higher ones */
+		if (va_subtree_max_gap(n->rb_right) >= size) {
+			n = n->rb_right;
+			continue;
+		}
+
+		/* Go back up to the next area not visited yet */
+		while (true) {
+			struct rb_node *prev = n;
+
+			n = rb_parent(n);
+			if (!n)
+				goto check_highest;
+			if (prev == n->rb_left) {
+				va = rb_entry(n, struct vmap_area, rb_node);
+				goto check_current;
+			}
+		}
+	}
+
+check_highest:
+	gap_start = 0;
+	if (!list_empty(&vmap_area_list)) {
+		va = list_entry(vmap_area_list.prev, struct vmap_area, list);
+		gap_start = va->va_end;
+	}
+	addr = ALIGN(max(gap_start, vstart), align);
+	if (addr < gap_start || addr + size < addr || addr + size > vend)
+		return vend;
+	return addr;
 }
 
 static void purge_vmap_area_lazy(void);
@@ -335,10 +440,8 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				int node, gfp_t gfp_mask)
 {
 	struct vmap_area *va;
-	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
-	struct vmap_area *first;
 
 	BUG_ON(!size);
 	BUG_ON(size & ~PAGE_MASK);
@@ -351,84 +454,14 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 retry:
 	spin_lock(&vmap_area_lock);
-	/*
-	 * Invalidate cache if we have more permissive parameters.
-	 * cached_hole_size notes the largest hole noticed _below_
-	 * the vmap_area cached in free_vmap_cache: if size fits
-	 * into that hole, we want to scan from vstart to reuse
-	 * the hole instead of allocating above free_vmap_cache.
-	 * Note that __free_vmap_area may update free_vmap_cache
-	 * without updating cached_hole_size or cached_align.
-	 */
-	if (!free_vmap_cache ||
-			size < cached_hole_size ||
-			vstart < cached_vstart ||
-			align < cached_align) {
-nocache:
-		cached_hole_size = 0;
-		free_vmap_cache = NULL;
-	}
-	/* record if we encounter less permissive parameters */
-	cached_vstart = vstart;
-	cached_align = align;
-
-	/* find starting point for our search */
-	if (free_vmap_cache) {
-		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-		addr = ALIGN(first->va_end, align);
-		if (addr < vstart)
-			goto nocache;
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-	} else {
-		addr = ALIGN(vstart, align);
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-		n = vmap_area_root.rb_node;
-		first = NULL;
-
-		while (n) {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				first = tmp;
-				if (tmp->va_start <= addr)
-					break;
-				n = n->rb_left;
-			} else
-				n = n->rb_right;
-		}
-
-		if (!first)
-			goto found;
-	}
-
-	/* from the starting point, walk areas until a suitable hole is found */
-	while (addr + size > first->va_start && addr + size <= vend) {
-		if (addr + cached_hole_size < first->va_start)
-			cached_hole_size = first->va_start - addr;
-		addr = ALIGN(first->va_end, align);
-		if (addr + size - 1 < addr)
-			goto overflow;
-
-		n = rb_next(&first->rb_node);
-		if (n)
-			first = rb_entry(n, struct vmap_area, rb_node);
-		else
-			goto found;
-	}
-
-found:
-	if (addr + size > vend)
+	addr = find_vmap_lowest_match(size, align, vstart, vend);
+	if (addr == vend)
 		goto overflow;
 
 	va->va_start = addr;
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
-	free_vmap_cache = &va->rb_node;
 	spin_unlock(&vmap_area_lock);
 
 	BUG_ON(va->va_start & (align-1));
@@ -461,26 +494,18 @@ static void rcu_free_va(struct rcu_head *head)
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	struct rb_node *next, *deepest;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
 
-	if (free_vmap_cache) {
-		if (va->va_end < cached_vstart) {
-			free_vmap_cache = NULL;
-		} else {
-			struct vmap_area *cache;
-			cache = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-			if (va->va_start <= cache->va_start) {
-				free_vmap_cache = rb_prev(&va->rb_node);
-				/*
-				 * We don't try to update cached_hole_size or
-				 * cached_align, but it won't go very wrong.
-				 */
-			}
-		}
-	}
+	next = rb_next(&va->rb_node);
+	deepest = rb_augment_erase_begin(&va->rb_node);
 	rb_erase(&va->rb_node, &vmap_area_root);
 	RB_CLEAR_NODE(&va->rb_node);
 	list_del_rcu(&va->list);
+	rb_augment_erase_end(deepest, vmap_area_augment_cb, NULL);
+	/* the next area now has va's space below it as well */
+	vmap_area_augment_path(next);
 
 	/*
 	 * Track the highest possible candidate for pcpu area
@@ -727,7 +752,7 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 #endif
 
 #define VMALLOC_PAGES		(VMALLOC_SPACE / PAGE_SIZE)
-#define VMAP_MAX_ALLOC		BITS_PER_LONG	/* 256K with 4K pages */
+#define VMAP_MAX_ALLOC		64	/* 256K with 4K pages */
 #define VMAP_BBMAP_BITS_MAX	1024	/* 4MB with 4K pages */
 #define VMAP_BBMAP_BITS_MIN	(VMAP_MAX_ALLOC*2)
 #define VMAP_MIN(x, y)		((x) < (y) ? (x) : (y)) /* can't use min() */
@@ -522,9 +522,12 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  @reclaimed says the page is being
+ * evicted by reclaim, rather than invalidated, in which case a shadow
+ * entry is left behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -570,10 +573,19 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		/*
+		 * Remember when the page was evicted, unless the mapping
+		 * is being torn down: the final truncate must not find
+		 * new shadows appearing behind it.
+		 */
+		if (reclaimed && page_is_file_cache(page) &&
+		    !mapping_exiting(mapping))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -596,7 +608,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -950,7 +962,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -2070,6 +2082,10 @@ restart:
 			break;
 	}
 	sc->nr_reclaimed += nr_reclaimed;
+	if (!scanning_global_lru(sc))
+		mem_cgroup_count_reclaim(sc->mem_cgroup,
+					 sc->nr_scanned - nr_scanned,
+					 nr_reclaimed);
 
 	/*
 	 * Even if we did not try to evict anon pages at all, we want to
@@ -2150,6 +2166,8 @@ static bool shrink_zones(int priority, struct zonelist *zonelist,
 	struct zone *zone;
 	unsigned long nr_soft_reclaimed;
 	unsigned long nr_soft_scanned;
+	unsigned long nr_prio_reclaimed;
+	unsigned long nr_prio_scanned;
 	bool aborted_reclaim = false;
 
 	for_each_zone_zonelist_nodemask(zone, z, zonelist,
@@ -2193,6 +2211,22 @@ static bool shrink_zones(int priority, struct zonelist *zonelist,
 			sc->nr_reclaimed += nr_soft_reclaimed;
 			sc->nr_scanned += nr_soft_scanned;
 			/* need some check for avoid more shrink_zone() */
+
+			/*
+			 * Take pages from cgroups with a reclaim priority
+			 * (background applications) before scanning the
+			 * zone LRU, which holds everybody's pages.  If that
+			 * alone met the target, leave the zone LRU alone.
+			 */
+			nr_prio_scanned = 0;
+			nr_prio_reclaimed = mem_cgroup_priority_reclaim(zone,
+						priority, sc->gfp_mask,
+						&nr_prio_scanned);
+			sc->nr_reclaimed += nr_prio_reclaimed;
+			sc->nr_scanned += nr_prio_scanned;
+			if (nr_prio_reclaimed &&
+			    sc->nr_reclaimed >= sc->nr_to_reclaim)
+				continue;
 		}
 
 		shrink_zone(priority, zone, sc);
@@ -2410,6 +2444,36 @@ unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
 	return sc.nr_reclaimed;
 }
 
+/*
+ * Reclaim from the LRU lists of @mem in @zone on behalf of global
+ * reclaim.  Unlike soft limit reclaim, the scan is bounded by @priority,
+ * so that a cgroup is aged at a rate comparable to the zone LRU.
+ */
+unsigned long mem_cgroup_shrink_zone(struct mem_cgroup *mem, gfp_t gfp_mask,
+				     unsigned int swappiness,
+				     struct zone *zone, int priority,
+				     unsigned long *nr_scanned)
+{
+	struct scan_control sc = {
+		.nr_scanned = 0,
+		.nr_to_reclaim = SWAP_CLUSTER_MAX,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.swappiness = swappiness,
+		.order = 0,
+		.mem_cgroup = mem,
+	};
+
+	sc.gfp_mask = (gfp_mask & GFP_RECLAIM_MASK) |
+			(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK);
+
+	shrink_zone(priority, zone, &sc);
+
+	*nr_scanned = sc.nr_scanned;
+	return sc.nr_reclaimed;
+}
+
 unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 					   gfp_t gfp_mask,
 					   bool noswap,
@@ -2565,6 +2629,8 @@ static unsigned long balance_pgdat(pg_data_t *pgdat, int order,
 	struct reclaim_state *reclaim_state = current->reclaim_state;
 	unsigned long nr_soft_reclaimed;
 	unsigned long nr_soft_scanned;
+	unsigned long nr_prio_reclaimed;
+	unsigned long nr_prio_scanned;
 	struct scan_control sc = {
 		.gfp_mask = GFP_KERNEL,
 		.may_unmap = 1,
@@ -2669,6 +2735,18 @@ loop_again:
 			sc.nr_reclaimed += nr_soft_reclaimed;
 			total_scanned += nr_soft_scanned;
 
+			/*
+			 * Likewise reclaim from prioritised cgroups first, so
+			 * that the shrink_zone() below may find the zone
+			 * balanced and spare the foreground.
+			 */
+			nr_prio_scanned = 0;
+			nr_prio_reclaimed = mem_cgroup_priority_reclaim(zone,
+							priority, sc.gfp_mask,
+							&nr_prio_scanned);
+			sc.nr_reclaimed += nr_prio_reclaimed;
+			total_scanned += nr_prio_scanned;
+
 			/*
 			 * We put equal pressure on every zone, unless
 			 * one zone has way too many pages free
@@ -2975,6 +3053,12 @@ static int kswapd(void *p)
 			balanced_classzone_idx = classzone_idx;
 			balanced_order = balance_pgdat(pgdat, order,
 						&balanced_classzone_idx);
+			/*
+			 * Reclaim only frees order-0 pages: hand the high-order
+			 * blocks this wakeup was for over to kcompactd, rather
+			 * than leaving them to the next direct compaction.
+			 */
+			wakeup_kcompactd(pgdat, order, classzone_idx);
 		}
 	}
 
@@ -462,6 +462,7 @@ void refresh_cpu_vm_stats(int cpu)
 #endif
 			}
 		cond_resched();
+		decay_pcp_high(zone, &p->pcp);
 #ifdef CONFIG_NUMA
 		/*
 		 * Deal with draining the remote pageset of this
@@ -708,6 +709,8 @@ const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -755,6 +758,13 @@ const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pcp_refill",
+	"pcp_drain",
+
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -763,6 +773,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_success",
+	"compact_stall_avoided",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1004,11 +1017,14 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              high range: %i-%i",
 			   i,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
-			   pageset->pcp.batch);
+			   pageset->pcp.batch,
+			   pageset->pcp.high_min,
+			   pageset->pcp.high_max);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -1021,6 +1037,15 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 		   zone->all_unreclaimable,
 		   zone->zone_start_pfn,
 		   zone->inactive_ratio);
+#ifdef CONFIG_ZONE_LOCK_STAT
+	seq_printf(m,
+		   "\n  lock_acquired:     %lu"
+		   "\n  lock_hold_ns:      %llu"
+		   "\n  lock_hold_max_ns:  %llu",
+		   zone->lock_acquired,
+		   (unsigned long long)zone->lock_hold_ns,
+		   (unsigned long long)zone->lock_hold_max_ns);
+#endif
 	seq_putc(m, '\n');
 }
 
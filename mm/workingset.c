@@ -0,0 +1,164 @@
+/*
+ * Workingset detection
+ *
+ * Copyright (C) 2013 Red Hat, Inc., Johannes Weiner
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/pagemap.h>
+
+/*
+ *		Double CLOCK lists
+ *
+ * Per zone, two clock lists are maintained for file pages: the
+ * inactive and the active list.  Freshly faulted pages start out at
+ * the head of the inactive list and page reclaim scans pages from the
+ * tail.  Pages that are accessed multiple times on the inactive list
+ * are promoted to the active list, to protect them from reclaim,
+ * whereas active pages are demoted to the inactive list when the
+ * active list grows too big.
+ *
+ * The trouble is that a working set that is bigger than the inactive
+ * list, but smaller than the active list plus the inactive list, is
+ * evicted before its second access can promote it: the cache thrashes
+ * although there would be room for it, as long as streaming or
+ * otherwise used-once pages keep the active list occupied.
+ *
+ *		Approximating inactive page access frequency
+ *
+ * Every eviction from and every activation out of the inactive list
+ * moves each page that is still on it one slot closer to the tail.
+ * A per-zone counter of these events, zone->inactive_age, is therefore
+ * a clock for the inactive list.
+ *
+ * When a page is evicted, a snapshot of this clock is stored in the
+ * now empty page cache slot, as an exceptional radix tree entry (the
+ * "shadow").  When the page is faulted back in, the difference between
+ * the current clock and the snapshot, the refault distance, is the
+ * number of slots the inactive list would have needed in addition to
+ * its current size to keep the page until this second access:
+ *
+ *   NR_inactive + (R - E)
+ *
+ * All the inactive list could be given is the space taken by the
+ * active list, so when the refault distance is not bigger than the
+ * number of active file pages, the page is activated right away to
+ * make it compete with the existing active pages for the memory:
+ *
+ *   R - E <= NR_active_file
+ *
+ * Both the number of refaults and the number of refaults activated this
+ * way are exported as "workingset_refault" and "workingset_activate" in
+ * /proc/vmstat.
+ *
+ *		Bounding the shadows
+ *
+ * Shadows are only removed by refaults and by truncation, and the radix
+ * tree nodes holding them stay allocated along with them, so they have
+ * to be bounded some other way.  Every eviction moves the clock on, so
+ * the n-th most recent shadow a mapping holds for a zone is at least
+ * n - 1 evictions old.  Past the number of active file pages, shadows
+ * can therefore no longer activate anything, and a mapping that holds
+ * that many gets no more until some of them are refaulted or truncated.
+ */
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone->zone_pgdat->node_id;
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	/*
+	 * The unsigned subtraction here gives an accurate distance
+	 * across inactive_age overflows in most cases.
+	 *
+	 * There is a special case: usually, shadow entries have a
+	 * short lifetime and are either refaulted or truncated along
+	 * with the inode before they get too old.  But a shadow that
+	 * stays around for more than EVICTION_MASK evictions will
+	 * give a bogus, too short distance: at worst a stale page is
+	 * activated once and ages out of the active list again.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected, or NULL
+ * if @mapping already holds as many shadows as can be of use.
+ * The caller must hold the mapping's tree_lock.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	if (mapping->nrshadows >= global_page_state(NR_ACTIVE_FILE))
+		return NULL;
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
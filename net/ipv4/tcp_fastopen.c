@@ -0,0 +1,197 @@
+/*
+ * TCP Fast Open: cookies and the client cookie cache.
+ *
+ * The server hands out a cookie that is the client address encrypted
+ * under a local secret; a client that presents it in a later SYN may
+ * carry data in that SYN, which is passed to the application before the
+ * three way handshake completes.  Clients remember the cookie (and the
+ * MSS the server announced) per destination, see tcp_send_syn_data().
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <net/inet_sock.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+static struct tcp_fastopen_context __rcu *tcp_fastopen_ctx;
+static DEFINE_SPINLOCK(tcp_fastopen_ctx_lock);
+
+static void tcp_fastopen_ctx_free(struct rcu_head *head)
+{
+	struct tcp_fastopen_context *ctx =
+		container_of(head, struct tcp_fastopen_context, rcu);
+
+	crypto_free_cipher(ctx->tfm);
+	kfree(ctx);
+}
+
+int tcp_fastopen_reset_cipher(void *key, unsigned int len)
+{
+	struct tcp_fastopen_context *ctx, *octx;
+	int err;
+
+	ctx = kmalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->tfm = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->tfm)) {
+		err = PTR_ERR(ctx->tfm);
+		goto out_free;
+	}
+	err = crypto_cipher_setkey(ctx->tfm, key, len);
+	if (err) {
+		crypto_free_cipher(ctx->tfm);
+		goto out_free;
+	}
+	memcpy(ctx->key, key, len);
+
+	spin_lock(&tcp_fastopen_ctx_lock);
+	octx = rcu_dereference_protected(tcp_fastopen_ctx,
+				lockdep_is_held(&tcp_fastopen_ctx_lock));
+	rcu_assign_pointer(tcp_fastopen_ctx, ctx);
+	spin_unlock(&tcp_fastopen_ctx_lock);
+
+	if (octx)
+		call_rcu(&octx->rcu, tcp_fastopen_ctx_free);
+	return 0;
+
+out_free:
+	kfree(ctx);
+	pr_err("TCP: Fast Open cipher setup failed: %d\n", err);
+	return err;
+}
+
+void tcp_fastopen_get_key(u32 *key)
+{
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx)
+		memcpy(key, ctx->key, TCP_FASTOPEN_KEY_LENGTH);
+	else
+		memset(key, 0, TCP_FASTOPEN_KEY_LENGTH);
+	rcu_read_unlock();
+}
+
+/* Computes the cookie of a client at @addr.  The first
+ * TCP_FASTOPEN_COOKIE_SIZE bytes of the AES block are the cookie; foc->len
+ * is left at -1 if no key is set up.
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__be32 peer_addr[4] = { addr, 0, 0, 0 };
+	u8 out[TCP_FASTOPEN_KEY_LENGTH];
+	struct tcp_fastopen_context *ctx;
+
+	rcu_read_lock();
+	ctx = rcu_dereference(tcp_fastopen_ctx);
+	if (ctx) {
+		crypto_cipher_encrypt_one(ctx->tfm, out, (u8 *)peer_addr);
+		memcpy(foc->val, out, TCP_FASTOPEN_COOKIE_SIZE);
+		foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Client side cookie cache.
+ *
+ * A small direct mapped table indexed by a hash of the destination.  A
+ * colliding destination simply evicts the entry; the worst case is one
+ * more cookie request.  Only IPv4 destinations are cached, so IPv6
+ * sockets never find a cookie and never send data in the SYN.
+ */
+#define TCP_FASTOPEN_CACHE_SIZE	256
+
+struct tcp_fastopen_cache_entry {
+	__be32				daddr;
+	u16				mss;
+	u16				syn_loss;
+	unsigned long			last_syn_loss;
+	struct tcp_fastopen_cookie	cookie;
+};
+
+static struct tcp_fastopen_cache_entry
+	tcp_fastopen_cache[TCP_FASTOPEN_CACHE_SIZE];
+static DEFINE_SPINLOCK(tcp_fastopen_cache_lock);
+
+static struct tcp_fastopen_cache_entry *tcp_fastopen_cache_slot(__be32 daddr)
+{
+	return &tcp_fastopen_cache[jhash_1word((__force u32)daddr, 0) &
+				   (TCP_FASTOPEN_CACHE_SIZE - 1)];
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	__be32 daddr = inet_sk(sk)->inet_daddr;
+	struct tcp_fastopen_cache_entry *e;
+
+	if (sk->sk_family != AF_INET)
+		return;
+
+	e = tcp_fastopen_cache_slot(daddr);
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (e->daddr == daddr) {
+		if (e->mss)
+			*mss = e->mss;
+		*cookie = e->cookie;
+		*syn_loss = e->syn_loss;
+		*last_syn_loss = *syn_loss ? e->last_syn_loss : 0;
+	}
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	__be32 daddr = inet_sk(sk)->inet_daddr;
+	struct tcp_fastopen_cache_entry *e;
+
+	if (sk->sk_family != AF_INET)
+		return;
+
+	e = tcp_fastopen_cache_slot(daddr);
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (e->daddr != daddr) {
+		memset(e, 0, sizeof(*e));
+		e->daddr = daddr;
+		e->cookie.len = -1;
+	}
+	if (mss)
+		e->mss = mss;
+	if (cookie->len > 0)
+		e->cookie = *cookie;
+	if (syn_lost) {
+		++e->syn_loss;
+		e->last_syn_loss = jiffies;
+	} else
+		e->syn_loss = 0;
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
+
+static int __init tcp_fastopen_init(void)
+{
+	u8 key[TCP_FASTOPEN_KEY_LENGTH];
+
+	get_random_bytes(key, sizeof(key));
+	return tcp_fastopen_reset_cipher(key, sizeof(key));
+}
+
+late_initcall(tcp_fastopen_init);
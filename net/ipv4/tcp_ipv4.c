@@ -773,7 +773,8 @@ static void tcp_v4_reqsk_send_ack(struct sock *sk, struct sk_buff *skb,
  */
 static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 			      struct request_sock *req,
-			      struct request_values *rvp)
+			      struct request_values *rvp,
+			      struct tcp_fastopen_cookie *foc)
 {
 	const struct inet_request_sock *ireq = inet_rsk(req);
 	struct flowi4 fl4;
@@ -784,7 +785,7 @@ static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 	if (!dst && (dst = inet_csk_route_req(sk, &fl4, req)) == NULL)
 		return -1;
 
-	skb = tcp_make_synack(sk, dst, req, rvp);
+	skb = tcp_make_synack(sk, dst, req, rvp, foc);
 
 	if (skb) {
 		__tcp_v4_send_check(skb, ireq->loc_addr, ireq->rmt_addr);
@@ -803,7 +804,7 @@ static int tcp_v4_rtx_synack(struct sock *sk, struct request_sock *req,
 			      struct request_values *rvp)
 {
 	TCP_INC_STATS_BH(sock_net(sk), TCP_MIB_RETRANSSEGS);
-	return tcp_v4_send_synack(sk, NULL, req, rvp);
+	return tcp_v4_send_synack(sk, NULL, req, rvp, NULL);
 }
 
 /*
@@ -1232,9 +1233,81 @@ static const struct tcp_request_sock_ops tcp_request_sock_ipv4_ops = {
 };
 #endif
 
+/*
+ * Passive Fast Open: the SYN carried a valid cookie, so create the child
+ * socket right away, queue the data of the SYN on it and make it available
+ * to accept().  The child stays in TCP_SYN_RECV until the handshake
+ * completes; it owns @req, from which its own retransmit timer resends the
+ * SYN-ACK (see tcp_retransmit_timer()).  @dst is consumed in all cases.
+ */
+static int tcp_v4_conn_req_fastopen(struct sock *sk, struct sk_buff *skb,
+				    struct request_sock *req,
+				    struct dst_entry *dst)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct request_sock *areq;
+	struct tcp_sock *ctp;
+	struct sock *child;
+
+	/* The accept queue frees its request_sock when the child is
+	 * accepted, while the child keeps @req until the handshake
+	 * completes, so queue a separate one.
+	 */
+	areq = inet_reqsk_alloc(&tcp_request_sock_ops);
+	if (!areq) {
+		dst_release(dst);
+		return -1;
+	}
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
+	if (child == NULL) {
+		__reqsk_free(areq);
+		return -1;
+	}
+
+	ctp = tcp_sk(child);
+	ctp->fastopen_rsk = req;
+	/* The listener must outlive the children counted in its
+	 * fastopen_qlen, see tcp_fastopen_release_rsk().
+	 */
+	sock_hold(sk);
+	tcp_rsk(req)->listener = sk;
+	atomic_inc(&tp->fastopen_qlen);
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never scaled. */
+	ctp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+	ctp->max_window = ctp->snd_wnd;
+
+	/* Queue the data of the SYN, acknowledged by our SYN-ACK. */
+	if (TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1) {
+		skb = skb_get(skb);
+		skb_dst_drop(skb);
+		__skb_pull(skb, tcp_hdr(skb)->doff * 4);
+		skb_set_owner_r(skb, child);
+		__skb_queue_tail(&child->sk_receive_queue, skb);
+		ctp->syn_data_acked = 1;
+	}
+	ctp->rcv_nxt = ctp->rcv_wup = TCP_SKB_CB(skb)->end_seq;
+	tcp_rsk(req)->rcv_nxt = ctp->rcv_nxt;
+
+	inet_csk_reqsk_queue_add(sk, areq, child);
+
+	tcp_v4_send_synack(child, NULL, req, NULL, NULL);
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+	return 0;
+}
+
 int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_extend_values tmp_ext;
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
 	struct tcp_options_received tmp_opt;
 	u8 *hash_location;
 	struct request_sock *req;
@@ -1288,7 +1361,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = TCP_MSS_DEFAULT;
 	tmp_opt.user_mss  = tp->rx_opt.user_mss;
-	tcp_parse_options(skb, &tmp_opt, &hash_location, 0);
+	tcp_parse_options(skb, &tmp_opt, &hash_location, 0, &foc);
 
 	if (tmp_opt.cookie_plus > 0 &&
 	    tmp_opt.saw_tstamp &&
@@ -1395,8 +1468,37 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
+	/* Fast Open: hand out a cookie on request, and accept the data of
+	 * a SYN carrying a valid one unless too many such children are
+	 * already waiting for their handshake to complete.
+	 */
+	if (!want_cookie && foc.len >= 0 &&
+	    (sysctl_tcp_fastopen & TFO_SERVER_ENABLE) &&
+	    tp->fastopen_max_qlen > 0) {
+		tcp_fastopen_cookie_gen(saddr, &valid_foc);
+		if (foc.len == 0) {
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+		} else if (foc.len != valid_foc.len ||
+			   memcmp(foc.val, valid_foc.val, foc.len)) {
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+		} else if (sk_acceptq_is_full(sk) ||
+			   atomic_read(&tp->fastopen_qlen) >=
+			   tp->fastopen_max_qlen) {
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+			valid_foc.len = -1;
+		} else {
+			if (tcp_v4_conn_req_fastopen(sk, skb, req, dst))
+				goto drop_and_free;
+			return 0;
+		}
+	}
+
 	if (tcp_v4_send_synack(sk, dst, req,
-			       (struct request_values *)&tmp_ext) ||
+			       (struct request_values *)&tmp_ext,
+			       valid_foc.len > 0 ? &valid_foc : NULL) ||
 	    want_cookie)
 		goto drop_and_free;
 
@@ -1764,6 +1866,7 @@ do_time_wait:
 	case TCP_TW_SYN: {
 		struct sock *sk2 = inet_lookup_listener(dev_net(skb->dev),
 							&tcp_hashinfo,
+							iph->saddr, th->source,
 							iph->daddr, th->dest,
 							inet_iif(skb));
 		if (sk2) {
@@ -1965,6 +2068,10 @@ void tcp_v4_destroy_sock(struct sock *sk)
 		tp->cookie_values = NULL;
 	}
 
+	/* TCP Fast Open */
+	tcp_fastopen_release_rsk(sk);
+	tcp_free_fastopen_req(tp);
+
 	percpu_counter_dec(&tcp_sockets_allocated);
 }
 EXPORT_SYMBOL(tcp_v4_destroy_sock);
@@ -2602,6 +2709,7 @@ struct proto tcp_prot = {
 	.sendmsg		= tcp_sendmsg,
 	.sendpage		= tcp_sendpage,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -317,11 +317,39 @@ static void tcp_probe_timer(struct sock *sk)
  *	The TCP retransmit timer.
  */
 
+/*
+ *	Timer for a passive Fast Open child: the SYN-ACK is not on its write
+ *	queue, it is rebuilt from the request_sock the child keeps until the
+ *	handshake completes.
+ */
+static void tcp_fastopen_synack_timer(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	int max_retries = icsk->icsk_syn_retries ? : sysctl_tcp_synack_retries;
+	struct request_sock *req = tcp_sk(sk)->fastopen_rsk;
+
+	if (icsk->icsk_retransmits >= max_retries) {
+		tcp_write_err(sk);
+		return;
+	}
+	req->rsk_ops->rtx_syn_ack(sk, req, NULL);
+	icsk->icsk_retransmits++;
+	inet_csk_reset_xmit_timer(sk, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT << icsk->icsk_retransmits,
+				  TCP_RTO_MAX);
+}
+
 void tcp_retransmit_timer(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct inet_connection_sock *icsk = inet_csk(sk);
 
+	if (tp->fastopen_rsk) {
+		WARN_ON_ONCE(sk->sk_state != TCP_SYN_RECV);
+		tcp_fastopen_synack_timer(sk);
+		goto out;
+	}
+
 	if (!tp->packets_out)
 		goto out;
 
@@ -135,12 +135,15 @@ static int udp_lib_lport_inuse(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 
 	sk_nulls_for_each(sk2, node, &hslot->head)
 		if (net_eq(sock_net(sk2), net) &&
 		    sk2 != sk &&
 		    (bitmap || udp_sk(sk2)->udp_port_hash == num) &&
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
 		    (*saddr_comp)(sk, sk2)) {
@@ -165,6 +168,7 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 	int res = 0;
 
 	spin_lock(&hslot2->lock);
@@ -173,6 +177,8 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 		    sk2 != sk &&
 		    (udp_sk(sk2)->udp_port_hash == num) &&
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
 		    (*saddr_comp)(sk, sk2)) {
@@ -405,19 +411,31 @@ static struct sock *udp4_lib_lookup2(struct net *net,
 {
 	struct sock *sk, *result;
 	struct hlist_nulls_node *node;
-	int score, badness;
+	int score, badness, matches = 0, reuseport;
+	u32 hash = 0;
 
 begin:
 	result = NULL;
 	badness = -1;
+	reuseport = 0;
 	udp_portaddr_for_each_entry_rcu(sk, node, &hslot2->head) {
 		score = compute_score2(sk, net, saddr, sport,
 				      daddr, hnum, dif);
 		if (score > badness) {
 			result = sk;
 			badness = score;
-			if (score == SCORE2_MAX)
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			} else if (score == SCORE2_MAX)
 				goto exact_match;
+		} else if (score == badness && reuseport) {
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -453,7 +471,8 @@ static struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 	unsigned short hnum = ntohs(dport);
 	unsigned int hash2, slot2, slot = udp_hashfn(net, hnum, udptable->mask);
 	struct udp_hslot *hslot2, *hslot = &udptable->hash[slot];
-	int score, badness;
+	int score, badness, matches = 0, reuseport;
+	u32 hash = 0;
 
 	rcu_read_lock();
 	if (hslot->count > 10) {
@@ -483,12 +502,24 @@ static struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 begin:
 	result = NULL;
 	badness = -1;
+	reuseport = 0;
 	sk_nulls_for_each_rcu(sk, node, &hslot->head) {
 		score = compute_score(sk, net, saddr, hnum, sport,
 				      daddr, dport, dif);
 		if (score > badness) {
 			result = sk;
 			badness = score;
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			}
+		} else if (score == badness && reuseport) {
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -762,6 +793,82 @@ send:
 	return err;
 }
 
+/*
+ * Unconnected sockets cannot use sk_dst_cache, so a sender that passes the
+ * same msg_name to each sendmsg() (or a whole sendmmsg() vector to one
+ * peer) would otherwise do a route lookup per datagram.  Keep the route of
+ * the last such send, keyed by the flow it was looked up for.  xfrm bundles
+ * are not cached: the fast path only knows about plain rtables.
+ */
+static bool udp_dst_cache_match(const struct flowi4 *a, const struct flowi4 *b)
+{
+	return a->daddr == b->daddr && a->saddr == b->saddr &&
+	       a->fl4_dport == b->fl4_dport && a->fl4_sport == b->fl4_sport &&
+	       a->flowi4_oif == b->flowi4_oif &&
+	       a->flowi4_mark == b->flowi4_mark &&
+	       a->flowi4_tos == b->flowi4_tos &&
+	       a->flowi4_flags == b->flowi4_flags &&
+	       a->flowi4_secid == b->flowi4_secid;
+}
+
+static struct rtable *udp_dst_cache_get(struct sock *sk, struct flowi4 *fl4)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct dst_entry *dst, *stale = NULL;
+	struct rtable *rt;
+
+	spin_lock(&sk->sk_dst_lock);
+	dst = up->dst_cache;
+	if (dst && !udp_dst_cache_match(&up->dst_cache_key, fl4))
+		dst = NULL;
+	if (dst && dst->obsolete && dst->ops->check(dst, 0) == NULL) {
+		stale = dst;
+		up->dst_cache = dst = NULL;
+	}
+	if (dst)
+		dst_hold(dst);
+	spin_unlock(&sk->sk_dst_lock);
+	dst_release(stale);
+
+	if (!dst)
+		return NULL;
+	rt = (struct rtable *)dst;
+	if (!fl4->saddr)
+		fl4->saddr = rt->rt_src;
+	if (!fl4->daddr)
+		fl4->daddr = rt->rt_dst;
+	return rt;
+}
+
+static void udp_dst_cache_set(struct sock *sk, const struct flowi4 *key,
+			      struct rtable *rt)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct dst_entry *old;
+
+	if (rt->dst.xfrm)
+		return;
+	spin_lock(&sk->sk_dst_lock);
+	old = up->dst_cache;
+	up->dst_cache = dst_clone(&rt->dst);
+	up->dst_cache_key = *key;
+	spin_unlock(&sk->sk_dst_lock);
+	dst_release(old);
+}
+
+void udp_dst_cache_reset(struct sock *sk)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct dst_entry *old;
+
+	spin_lock(&sk->sk_dst_lock);
+	old = up->dst_cache;
+	up->dst_cache = NULL;
+	spin_unlock(&sk->sk_dst_lock);
+	dst_release(old);
+}
+EXPORT_SYMBOL(udp_dst_cache_reset);
+
 /*
  * Push out all pending data as one UDP datagram. Socket is locked.
  */
@@ -930,13 +1037,21 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 				   faddr, saddr, dport, inet->inet_sport);
 
 		security_sk_classify_flow(sk, flowi4_to_flowi(fl4));
-		rt = ip_route_output_flow(net, fl4, sk);
-		if (IS_ERR(rt)) {
-			err = PTR_ERR(rt);
-			rt = NULL;
-			if (err == -ENETUNREACH)
-				IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
-			goto out;
+		if (!connected)
+			rt = udp_dst_cache_get(sk, fl4);
+		if (rt == NULL) {
+			struct flowi4 key = *fl4;
+
+			rt = ip_route_output_flow(net, fl4, sk);
+			if (IS_ERR(rt)) {
+				err = PTR_ERR(rt);
+				rt = NULL;
+				if (err == -ENETUNREACH)
+					IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
+				goto out;
+			}
+			if (!connected)
+				udp_dst_cache_set(sk, &key, rt);
 		}
 
 		err = -EACCES;
@@ -1719,6 +1834,7 @@ void udp_destroy_sock(struct sock *sk)
 	bool slow = lock_sock_fast(sk);
 	udp_flush_pending_frames(sk);
 	unlock_sock_fast(sk, slow);
+	udp_dst_cache_reset(sk);
 }
 
 /*
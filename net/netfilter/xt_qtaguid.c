@@ -15,13 +15,16 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
+#include <linux/rculist.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
+#include <net/genetlink.h>
 #include <net/sock.h>
 #include <net/tcp.h>
 #include <net/udp.h>
@@ -184,17 +187,23 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  *     iface_stat_list_lock
  *
  * qtaguid_mt()
+ *   iface_stat_update_from_skb()
+ *     rcu_read_lock()
+ *       (iface_stat_list)
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock()
+ *         (sock_tag_cache)
+ *       Only on a sock_tag_cache miss:
+ *         (iface_stat_list)
+ *         get_sock_tag()
+ *           sock_tag_list_lock
+ *         get_active_counter_set()
+ *           tag_counter_set_list_lock
+ *         struct iface_stat->tag_stat_list_lock
+ *
+ * The match never takes a lock to bump the counters: they are per cpu and
+ * only get added up by the readers.
  *
  *
  * qtaguid_ctrl_parse()
@@ -235,6 +244,10 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+static atomic_t sock_tag_cache_gen = ATOMIC_INIT(0);
+static DEFINE_PER_CPU(struct sock_tag_cache_entry,
+		      sock_tag_cache[SOCK_TAG_CACHE_SIZE]);
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -258,6 +271,22 @@ static bool can_read_other_uid_stats(uid_t uid)
 		|| unlikely(current_fsuid() == xt_qtaguid_ctrl_file->uid);
 }
 
+/*
+ * Must be called after anything that could change which tag_stat a
+ * {sock, uid, net_dev} gets billed to, and before a tag_stat is freed.
+ */
+static void sock_tag_cache_invalidate(void)
+{
+	atomic_inc(&sock_tag_cache_gen);
+	smp_mb__after_atomic_inc();
+}
+
+static struct data_counters_pcpu *data_counters_alloc(void)
+{
+	return kcalloc(nr_cpu_ids, sizeof(struct data_counters_pcpu),
+		       GFP_ATOMIC);
+}
+
 static inline void dc_add_byte_packets(struct data_counters *counters, int set,
 				  enum ifs_tx_rx direction,
 				  enum ifs_proto ifs_proto,
@@ -331,6 +360,25 @@ static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 	return rb_entry(&node->node, struct tag_stat, tn.node);
 }
 
+/* Returns the first node with a tag bigger than the given one, or NULL */
+static struct rb_node *tag_node_tree_search_next(struct rb_root *root,
+						 tag_t tag)
+{
+	struct rb_node *node = root->rb_node;
+	struct rb_node *next = NULL;
+
+	while (node) {
+		struct tag_node *data = rb_entry(node, struct tag_node, node);
+		if (tag_compare(tag, data->tag) < 0) {
+			next = node;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+	return next;
+}
+
 static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
@@ -747,7 +795,9 @@ static int get_active_counter_set(tag_t tag)
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock().
+ * iface_entries are never deleted, so they stay valid after the lock is
+ * dropped.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -760,7 +810,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -787,9 +837,9 @@ static int pp_iface_stat_line(bool header, char *outp,
 			       "tx_other_bytes tx_other_packets\n"
 			);
 	} else {
-		struct data_counters *cnts;
+		struct data_counters counters, *cnts = &counters;
 		int cnt_set = 0;   /* We only use one set for the device */
-		cnts = &iface_entry->totals_via_skb;
+		data_counters_fold(cnts, iface_entry->totals_via_skb);
 		len = snprintf(
 			outp, char_count,
 			"%s "
@@ -953,6 +1003,8 @@ static void _iface_stat_set_active(struct iface_stat *entry,
 				   struct net_device *net_dev,
 				   bool activate)
 {
+	/* Cached lookups are keyed on the net_dev */
+	sock_tag_cache_invalidate();
 	if (activate) {
 		entry->net_dev = net_dev;
 		entry->active = true;
@@ -990,6 +1042,14 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
+	new_iface->totals_via_skb = data_counters_alloc();
+	if (new_iface->totals_via_skb == NULL) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "counters alloc failed\n", net_dev->name);
+		kfree(new_iface->ifname);
+		kfree(new_iface);
+		return NULL;
+	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
 	_iface_stat_set_active(new_iface, net_dev, true);
@@ -1003,6 +1063,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		kfree(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -1010,7 +1071,11 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	/*
+	 * Add at the tail so that the position of existing entries never
+	 * changes, the netlink dump resumes from it.
+	 */
+	list_add_tail_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1191,16 +1256,22 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * Returns true and the sock's tag in *tag if it is tagged.
+ * The sock_tag itself can go away as soon as the lock is dropped.
+ */
+static bool get_sock_tag(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	MT_DEBUG("qtaguid: get_sock_tag(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
+		return false;
 	spin_lock_bh(&sock_tag_list_lock);
 	sock_tag_entry = get_sock_stat_nl(sk);
+	if (sock_tag_entry)
+		*tag = sock_tag_entry->tag;
 	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	return sock_tag_entry != NULL;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1224,10 +1295,19 @@ static int ipx_proto(const struct sk_buff *skb,
 	return tproto;
 }
 
+/*
+ * Bumps this cpu's copy of the counters.
+ * The match runs with BHs disabled (see ipt_do_table()), so nothing else
+ * can touch them under us.
+ */
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct data_counters_pcpu *pcpu_dc, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_pcpu *dcp = &pcpu_dc[smp_processor_id()];
+	struct data_counters *dc = &dcp->dc;
+
+	u64_stats_update_begin(&dcp->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1241,6 +1321,7 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&dcp->syncp);
 }
 
 /*
@@ -1342,33 +1423,31 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
+	data_counters_update(entry->totals_via_skb, 0, direction, proto,
 			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	rcu_read_unlock();
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(tag_entry->counters, active_set, direction,
 			     proto, bytes);
 	if (tag_entry->parent_counters)
 		data_counters_update(tag_entry->parent_counters, active_set,
@@ -1392,59 +1471,45 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->counters = data_counters_alloc();
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
-			       const struct sock *sk, enum ifs_tx_rx direction,
-			       int proto, int bytes)
+static void tag_stat_free_rcu(struct rcu_head *head)
 {
-	struct tag_stat *tag_stat_entry;
-	tag_t tag, acct_tag;
-	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
-	struct iface_stat *iface_entry;
-	struct tag_stat *new_tag_stat = NULL;
-	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
-		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
-		 ifname, uid, sk, direction, proto, bytes);
-
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
 
-	iface_entry = get_iface_entry(ifname);
-	if (!iface_entry) {
-		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
-		       ifname);
-		return;
-	}
-	/* It is ok to process data when an iface_entry is inactive */
+	kfree(ts_entry->counters);
+	kfree(ts_entry);
+}
 
-	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
-		 ifname, iface_entry);
+/*
+ * Find the entry for {acct_tag, uid_tag} within the interface, creating it
+ * and its {0, uid_tag} parent if needed.
+ * iface_entry->tag_stat_list_lock should be held.
+ */
+static struct tag_stat *get_if_tag_stat(struct iface_stat *iface_entry,
+					tag_t tag)
+{
+	tag_t acct_tag = get_atag_from_tag(tag);
+	tag_t uid_tag = get_utag_from_tag(tag);
+	struct data_counters_pcpu *uid_tag_counters;
+	struct tag_stat *tag_stat_entry;
+	struct tag_stat *new_tag_stat = NULL;
 
-	/*
-	 * Look for a tagged sock.
-	 * It will have an acct_uid.
-	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
-		acct_tag = get_atag_from_tag(tag);
-		uid_tag = get_utag_from_tag(tag);
-	} else {
-		acct_tag = make_atag_from_value(0);
-		tag = combine_atag_with_uid(acct_tag, uid);
-		uid_tag = make_tag_from_uid(uid);
-	}
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
 	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
-
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      tag);
 	if (tag_stat_entry) {
@@ -1452,9 +1517,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		return tag_stat_entry;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1468,17 +1531,17 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
-			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+			return NULL;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
 		/* Create the child {acct_tag, uid_tag} and hook up parent. */
 		new_tag_stat = create_if_tag_stat(iface_entry, tag);
 		if (!new_tag_stat)
-			goto unlock;
+			return NULL;
 		new_tag_stat->parent_counters = uid_tag_counters;
 	} else {
 		/*
@@ -1491,9 +1554,78 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
-unlock:
+	return new_tag_stat;
+}
+
+static void if_tag_stat_update(const struct net_device *el_dev, uid_t uid,
+			       const struct sock *sk, enum ifs_tx_rx direction,
+			       int proto, int bytes)
+{
+	struct sock_tag_cache_entry *cache_entry;
+	struct tag_stat *tag_stat_entry;
+	struct iface_stat *iface_entry;
+	unsigned int gen;
+	int active_set;
+	tag_t tag;
+	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
+		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
+		 el_dev->name, uid, sk, direction, proto, bytes);
+
+	rcu_read_lock();
+	/*
+	 * Sample the generation before doing any lookup, so that a result
+	 * that went stale while we were looking never looks valid.
+	 */
+	gen = atomic_read(&sock_tag_cache_gen);
+	smp_rmb();
+	cache_entry = &__get_cpu_var(sock_tag_cache)[
+		hash_ptr((void *)sk, SOCK_TAG_CACHE_BITS)];
+	if (cache_entry->ts_entry && cache_entry->gen == gen &&
+	    cache_entry->sk == sk && cache_entry->net_dev == el_dev &&
+	    cache_entry->uid == uid) {
+		tag_stat_update(cache_entry->ts_entry, cache_entry->active_set,
+				direction, proto, bytes);
+		goto unlock;
+	}
+
+	iface_entry = get_iface_entry(el_dev->name);
+	if (!iface_entry) {
+		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
+		       el_dev->name);
+		goto unlock;
+	}
+	/* It is ok to process data when an iface_entry is inactive */
+
+	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
+		 el_dev->name, iface_entry);
+
+	/*
+	 * Look for a tagged sock.
+	 * It will have an acct_uid.
+	 */
+	if (!get_sock_tag(sk, &tag))
+		tag = combine_atag_with_uid(make_atag_from_value(0), uid);
+	active_set = get_active_counter_set(tag);
+
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+	tag_stat_entry = get_if_tag_stat(iface_entry, tag);
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	if (!tag_stat_entry)
+		goto unlock;
+	/*
+	 * A concurrent delete only frees the tag_stat after a grace period,
+	 * and its sock_tag_cache_invalidate() makes this entry stale.
+	 */
+	tag_stat_update(tag_stat_entry, active_set, direction, proto, bytes);
+
+	cache_entry->sk = sk;
+	cache_entry->net_dev = el_dev;
+	cache_entry->uid = uid;
+	cache_entry->gen = gen;
+	cache_entry->active_set = active_set;
+	cache_entry->ts_entry = tag_stat_entry;
+unlock:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1512,6 +1644,10 @@ static int iface_netdev_event_handler(struct notifier_block *nb,
 		iface_stat_create(dev, NULL);
 		atomic64_inc(&qtu_events.iface_events);
 		break;
+	case NETDEV_CHANGENAME:
+		/* Cached lookups map a net_dev to an iface by its old name */
+		sock_tag_cache_invalidate();
+		break;
 	case NETDEV_DOWN:
 	case NETDEV_UNREGISTER:
 		iface_stat_update(dev, event == NETDEV_DOWN);
@@ -1740,7 +1876,7 @@ static void account_for_uid(const struct sk_buff *skb,
 			 par->hooknum, el_dev->name, el_dev->type,
 			 par->family, proto);
 
-		if_tag_stat_update(el_dev->name, uid,
+		if_tag_stat_update(el_dev, uid,
 				skb->sk ? skb->sk : alternate_sk,
 				par->in ? IFS_RX : IFS_TX,
 				proto, skb->len);
@@ -2123,6 +2259,7 @@ static int ctrl_cmd_delete(const char *input)
 		}
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
+	sock_tag_cache_invalidate();
 
 	sock_tag_tree_erase(&st_to_free_tree);
 
@@ -2141,6 +2278,7 @@ static int ctrl_cmd_delete(const char *input)
 		kfree(tcs_entry);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
+	sock_tag_cache_invalidate();
 
 	/*
 	 * If acct_tag is 0, then all entries belonging to uid are
@@ -2169,7 +2307,9 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				/* The match might still be using it. */
+				sock_tag_cache_invalidate();
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2258,6 +2398,7 @@ static int ctrl_cmd_counter_set(const char *input)
 	}
 	tcs->active_set = counter_set;
 	spin_unlock_bh(&tag_counter_set_list_lock);
+	sock_tag_cache_invalidate();
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
 
@@ -2396,6 +2537,7 @@ static int ctrl_cmd_tag(const char *input)
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
+	sock_tag_cache_invalidate();
 	/* We keep the ref to the socket (file) until it is untagged */
 	CT_DEBUG("qtaguid: ctrl_tag(%s): done st@%p ...->f_count=%ld\n",
 		 input, sock_tag_entry,
@@ -2485,6 +2627,7 @@ static int ctrl_cmd_untag(const char *input)
 	 */
 	tag_ref_entry->num_sock_tags--;
 	spin_unlock_bh(&sock_tag_list_lock);
+	sock_tag_cache_invalidate();
 	/*
 	 * Release the sock_fd that was grabbed at tag time,
 	 * and once more for the sockfd_lookup() here.
@@ -2574,6 +2717,8 @@ struct proc_print_info {
 	char **num_items_returned;
 	struct iface_stat *iface_entry;
 	struct tag_stat *ts_entry;
+	/* ts_entry's per cpu counters, added up */
+	struct data_counters ts_counters;
 	int item_index;
 	int items_to_skip;
 	int char_count;
@@ -2614,7 +2759,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		cnts = &ppi->ts_counters;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2729,6 +2874,8 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 		     node;
 		     node = rb_next(node)) {
 			ppi.ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			data_counters_fold(&ppi.ts_counters,
+					   ppi.ts_entry->counters);
 			if (!pp_sets(&ppi)) {
 				spin_unlock_bh(
 					&ppi.iface_entry->tag_stat_list_lock);
@@ -2744,6 +2891,193 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 	return ppi.outp - page;
 }
 
+/*------------------------------------------*/
+/*
+ * Binary stats export, see include/linux/netfilter/xt_qtaguid.h.
+ * Each dump gets a new generation. When a dump sees that the counters of
+ * an entry changed, it stamps the entry with the generation after the
+ * last one handed out: every dump running or done may have missed the
+ * change, and those that start later will see it. "Changed since N" is
+ * then just a compare, whichever client did the dumps in between, and
+ * however dumps overlap.
+ */
+static atomic_t qtu_stats_gen = ATOMIC_INIT(0);
+
+/* Dump state kept in netlink_callback->args[] across parts */
+enum {
+	QTU_DUMP_IFACE,		/* position of the iface in iface_stat_list */
+	QTU_DUMP_PHASE,		/* QTU_DUMP_PHASE_* */
+	QTU_DUMP_TAG_LO,	/* last tag dumped for the iface */
+	QTU_DUMP_TAG_HI,
+	QTU_DUMP_GEN,
+	QTU_DUMP_SINCE,
+};
+
+enum {
+	QTU_DUMP_PHASE_IFACE,	/* iface totals not dumped yet */
+	QTU_DUMP_PHASE_FIRST,	/* no tag_stat dumped yet */
+	QTU_DUMP_PHASE_NEXT,	/* tag_stats up to QTU_DUMP_TAG_* dumped */
+};
+
+static struct genl_family qtaguid_genl_family = {
+	.id = GENL_ID_GENERATE,
+	.name = QTAGUID_GENL_NAME,
+	.version = QTAGUID_GENL_VERSION,
+	.maxattr = QTAGUID_A_MAX,
+};
+
+static const struct nla_policy qtaguid_genl_policy[QTAGUID_A_MAX + 1] = {
+	[QTAGUID_A_SINCE_GEN] = { .type = NLA_U32 },
+};
+
+/*
+ * Caller must hold the iface tag_stat_list_lock.
+ * A full dump (since == 0) includes every entry, even one with no traffic.
+ */
+static bool stats_changed_since(struct data_counters *dc,
+				uint64_t *dump_packets, u32 *changed_gen,
+				u32 since)
+{
+	uint64_t packets = 0;
+	int set;
+
+	for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+		packets += dc_sum_packets(dc, set, IFS_RX)
+			+ dc_sum_packets(dc, set, IFS_TX);
+	if (packets != *dump_packets) {
+		*dump_packets = packets;
+		*changed_gen = atomic_read(&qtu_stats_gen) + 1;
+	}
+	return !since || *changed_gen > since;
+}
+
+static int qtaguid_genl_fill(struct sk_buff *skb, struct netlink_callback *cb,
+			     u32 gen, const char *ifname, int attrtype,
+			     tag_t tag, struct data_counters *dc)
+{
+	struct qtaguid_stats stats;
+	void *hdr;
+
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).pid, cb->nlh->nlmsg_seq,
+			  &qtaguid_genl_family, NLM_F_MULTI,
+			  QTAGUID_CMD_GET_STATS);
+	if (!hdr)
+		return -EMSGSIZE;
+
+	BUILD_BUG_ON(sizeof(stats.bpc) != sizeof(dc->bpc));
+	stats.acct_tag = get_atag_from_tag(tag);
+	stats.uid = get_uid_from_tag(tag);
+	stats.pad = 0;
+	memcpy(stats.bpc, dc->bpc, sizeof(stats.bpc));
+
+	NLA_PUT_U32(skb, QTAGUID_A_GEN, gen);
+	NLA_PUT_STRING(skb, QTAGUID_A_IFNAME, ifname);
+	NLA_PUT(skb, attrtype, sizeof(stats), &stats);
+	return genlmsg_end(skb, hdr);
+
+nla_put_failure:
+	genlmsg_cancel(skb, hdr);
+	return -EMSGSIZE;
+}
+
+static int qtaguid_genl_dump_stats(struct sk_buff *skb,
+				   struct netlink_callback *cb)
+{
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	struct data_counters dc;
+	struct rb_node *node;
+	long iface_pos = 0;
+	u32 gen, since;
+	tag_t tag;
+
+	if (unlikely(module_passive))
+		return 0;
+
+	if (!cb->args[QTU_DUMP_GEN]) {
+		struct nlattr *attrs[QTAGUID_A_MAX + 1];
+		int err;
+
+		err = nlmsg_parse(cb->nlh, GENL_HDRLEN, attrs, QTAGUID_A_MAX,
+				  qtaguid_genl_policy);
+		if (err)
+			return err;
+		if (attrs[QTAGUID_A_SINCE_GEN])
+			cb->args[QTU_DUMP_SINCE] =
+				nla_get_u32(attrs[QTAGUID_A_SINCE_GEN]);
+		cb->args[QTU_DUMP_GEN] = atomic_inc_return(&qtu_stats_gen);
+	}
+	gen = cb->args[QTU_DUMP_GEN];
+	since = cb->args[QTU_DUMP_SINCE];
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
+		if (iface_pos++ < cb->args[QTU_DUMP_IFACE])
+			continue;
+
+		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		if (cb->args[QTU_DUMP_PHASE] == QTU_DUMP_PHASE_IFACE) {
+			data_counters_fold(&dc, iface_entry->totals_via_skb);
+			if (stats_changed_since(&dc, &iface_entry->dump_packets,
+						&iface_entry->changed_gen,
+						since)
+			    && qtaguid_genl_fill(skb, cb, gen,
+						 iface_entry->ifname,
+						 QTAGUID_A_IFACE_STATS,
+						 0, &dc) < 0)
+				goto full;
+			cb->args[QTU_DUMP_PHASE] = QTU_DUMP_PHASE_FIRST;
+		}
+
+		if (cb->args[QTU_DUMP_PHASE] == QTU_DUMP_PHASE_FIRST) {
+			node = rb_first(&iface_entry->tag_stat_tree);
+		} else {
+			tag = (u32)cb->args[QTU_DUMP_TAG_LO]
+				| (tag_t)cb->args[QTU_DUMP_TAG_HI] << 32;
+			node = tag_node_tree_search_next(
+				&iface_entry->tag_stat_tree, tag);
+		}
+		for (; node; node = rb_next(node)) {
+			ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			tag = ts_entry->tn.tag;
+			/* Detailed tags are not available to everybody */
+			if (get_atag_from_tag(tag)
+			    && !can_read_other_uid_stats(get_uid_from_tag(tag)))
+				continue;
+			data_counters_fold(&dc, ts_entry->counters);
+			if (stats_changed_since(&dc, &ts_entry->dump_packets,
+						&ts_entry->changed_gen,
+						since)
+			    && qtaguid_genl_fill(skb, cb, gen,
+						 iface_entry->ifname,
+						 QTAGUID_A_STATS, tag, &dc) < 0)
+				goto full;
+			cb->args[QTU_DUMP_PHASE] = QTU_DUMP_PHASE_NEXT;
+			cb->args[QTU_DUMP_TAG_LO] = (u32)tag;
+			cb->args[QTU_DUMP_TAG_HI] = (u32)(tag >> 32);
+		}
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+
+		cb->args[QTU_DUMP_IFACE] = iface_pos;
+		cb->args[QTU_DUMP_PHASE] = QTU_DUMP_PHASE_IFACE;
+	}
+	rcu_read_unlock();
+	return skb->len;
+
+full:
+	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	rcu_read_unlock();
+	return skb->len;
+}
+
+static struct genl_ops qtaguid_genl_ops[] = {
+	{
+		.cmd = QTAGUID_CMD_GET_STATS,
+		.dumpit = qtaguid_genl_dump_stats,
+		.policy = qtaguid_genl_policy,
+	},
+};
+
 /*------------------------------------------*/
 static int qtudev_open(struct inode *inode, struct file *file)
 {
@@ -2883,7 +3217,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
-
+	sock_tag_cache_invalidate();
 
 	sock_tag_tree_erase(&st_to_free_tree);
 
@@ -2969,7 +3303,10 @@ static int __init qtaguid_mt_init(void)
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
-	    || misc_register(&qtu_device))
+	    || misc_register(&qtu_device)
+	    || genl_register_family_with_ops(&qtaguid_genl_family,
+					     qtaguid_genl_ops,
+					     ARRAY_SIZE(qtaguid_genl_ops)))
 		return -1;
 	return 0;
 }
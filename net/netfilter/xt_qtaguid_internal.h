@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -179,6 +183,45 @@ struct data_counters {
 	struct byte_packet_counters bpc[IFS_MAX_COUNTER_SETS][IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
 };
 
+/*
+ * The match bumps its own cpu's copy of the counters without any lock.
+ * They are only added up when somebody reads them, see data_counters_fold().
+ * This is an array of nr_cpu_ids entries rather than alloc_percpu()
+ * memory because new tag_stats get created from the (atomic) match path.
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+static inline void data_counters_fold(struct data_counters *dc,
+				      struct data_counters_pcpu *pcpu_dc)
+{
+	int cpu, set, dir, proto;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		struct data_counters_pcpu *dcp = &pcpu_dc[cpu];
+		struct data_counters snap;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_bh(&dcp->syncp);
+			snap = dcp->dc;
+		} while (u64_stats_fetch_retry_bh(&dcp->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					dc->bpc[set][dir][proto].bytes +=
+						snap.bpc[set][dir][proto].bytes;
+					dc->bpc[set][dir][proto].packets +=
+						snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
 static inline uint64_t dc_sum_bytes(struct data_counters *counters,
 				    int set,
 				    enum ifs_tx_rx direction)
@@ -206,12 +249,23 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct data_counters_pcpu *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters_pcpu *parent_counters;
+	/*
+	 * The match may still be using a tag_stat it found in the sock tag
+	 * cache after it got deleted, so they are freed after a grace period.
+	 */
+	struct rcu_head rcu;
+	/*
+	 * Packets seen by the last netlink dump, and the generation from which
+	 * on dumps see them. Protected by the iface tag_stat_list_lock.
+	 */
+	uint64_t dump_packets;
+	u32 changed_gen;
 };
 
 struct iface_stat {
@@ -222,7 +276,7 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	struct data_counters_pcpu *totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -239,6 +293,10 @@ struct iface_stat {
 
 	struct rb_root tag_stat_tree;
 	spinlock_t tag_stat_list_lock;
+
+	/* Same as for tag_stat, for totals_via_skb */
+	uint64_t dump_packets;
+	u32 changed_gen;
 };
 
 /* This is needed to create proc_dir_entries from atomic context. */
@@ -265,6 +323,25 @@ struct sock_tag {
 	tag_t tag;
 };
 
+/*
+ * Per cpu cache of the tag_stat that a {sock, uid, net_dev} was last billed
+ * to, so that the match does not have to search sock_tag_tree and the
+ * iface tag_stat_tree for every packet.
+ * An entry is only valid while its gen matches the global cache generation,
+ * which gets bumped by anything that could change the result of the lookup.
+ */
+#define SOCK_TAG_CACHE_BITS 4
+#define SOCK_TAG_CACHE_SIZE (1 << SOCK_TAG_CACHE_BITS)
+
+struct sock_tag_cache_entry {
+	const struct sock *sk;  /* Only used as a number, never dereferenced */
+	const struct net_device *net_dev;
+	uid_t uid;
+	unsigned int gen;
+	int active_set;
+	struct tag_stat *ts_entry;
+};
+
 struct qtaguid_event_counts {
 	/* Various successful events */
 	atomic64_t sockets_tagged;
@@ -98,6 +98,7 @@
 #include <linux/in.h>
 #include <linux/fs.h>
 #include <linux/slab.h>
+#include <linux/hash.h>
 #include <asm/uaccess.h>
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
@@ -115,12 +116,16 @@
 #include <net/checksum.h>
 #include <linux/security.h>
 
-static struct hlist_head unix_socket_table[UNIX_HASH_SIZE + 1];
-static DEFINE_SPINLOCK(unix_table_lock);
+/*
+ * Bound sockets live in the lower UNIX_HASH_SIZE buckets, by name or by
+ * inode; unbound ones are spread over the upper half by address.  Every
+ * bucket has its own lock, and sk->sk_hash records the bucket a socket
+ * is on.
+ */
+static struct hlist_head unix_socket_table[2 * UNIX_HASH_SIZE];
+static spinlock_t unix_table_locks[2 * UNIX_HASH_SIZE];
 static atomic_long_t unix_nr_socks;
 
-#define unix_sockets_unbound	(&unix_socket_table[UNIX_HASH_SIZE])
-
 #define UNIX_ABSTRACT(sk)	(unix_sk(sk)->addr->hash != UNIX_HASH_SIZE)
 
 #ifdef CONFIG_SECURITY_NETWORK
@@ -143,7 +148,9 @@ static inline void unix_set_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 
 /*
  *  SMP locking strategy:
- *    hash table is protected with spinlock unix_table_lock
+ *    each hash bucket is protected with its spinlock in unix_table_locks;
+ *    binding moves a socket between two buckets with both locks held,
+ *    taken in index order (see unix_table_double_lock())
  *    each socket state is protected by separate spin lock.
  */
 
@@ -184,6 +191,37 @@ static struct sock *unix_peer_get(struct sock *s)
 	return peer;
 }
 
+/*
+ * sendto() on a connected datagram socket usually names the peer it is
+ * connected to.  Abstract names can be compared with the peer's address
+ * directly, which saves the hash lookup and the bucket lock; filesystem
+ * names still go through unix_find_other() and its path walk.  A dead
+ * peer is left to the lookup too, which finds whoever rebound the name.
+ */
+static struct sock *unix_peer_get_byname(struct sock *s,
+					 struct sockaddr_un *sunname, int len)
+{
+	struct unix_address *addr;
+	struct sock *peer;
+
+	if (sunname->sun_path[0])
+		return NULL;
+
+	unix_state_lock(s);
+	peer = unix_peer(s);
+	if (peer) {
+		addr = unix_sk(peer)->addr;
+		if (addr && addr->len == len &&
+		    !memcmp(addr->name, sunname, len) &&
+		    !sock_flag(peer, SOCK_DEAD))
+			sock_hold(peer);
+		else
+			peer = NULL;
+	}
+	unix_state_unlock(s);
+	return peer;
+}
+
 static inline void unix_release_addr(struct unix_address *addr)
 {
 	if (atomic_dec_and_test(&addr->refcnt))
@@ -220,29 +258,54 @@ static int unix_mkname(struct sockaddr_un *sunaddr, int len, unsigned *hashp)
 	return len;
 }
 
+static inline unsigned int unix_unbound_hash(struct sock *sk)
+{
+	return UNIX_HASH_SIZE + hash_ptr(sk, UNIX_HASH_BITS);
+}
+
+/* One bucket is always an unbound one and the other a bound one. */
+static void unix_table_double_lock(unsigned int hash1, unsigned int hash2)
+{
+	if (hash1 > hash2)
+		swap(hash1, hash2);
+	spin_lock(&unix_table_locks[hash1]);
+	spin_lock_nested(&unix_table_locks[hash2], SINGLE_DEPTH_NESTING);
+}
+
+static void unix_table_double_unlock(unsigned int hash1, unsigned int hash2)
+{
+	spin_unlock(&unix_table_locks[hash1]);
+	spin_unlock(&unix_table_locks[hash2]);
+}
+
 static void __unix_remove_socket(struct sock *sk)
 {
 	sk_del_node_init(sk);
 }
 
-static void __unix_insert_socket(struct hlist_head *list, struct sock *sk)
+static void __unix_insert_socket(unsigned int hash, struct sock *sk)
 {
 	WARN_ON(!sk_unhashed(sk));
-	sk_add_node(sk, list);
+	sk->sk_hash = hash;
+	sk_add_node(sk, &unix_socket_table[hash]);
 }
 
 static inline void unix_remove_socket(struct sock *sk)
 {
-	spin_lock(&unix_table_lock);
+	spinlock_t *lock = &unix_table_locks[sk->sk_hash];
+
+	spin_lock(lock);
 	__unix_remove_socket(sk);
-	spin_unlock(&unix_table_lock);
+	spin_unlock(lock);
 }
 
-static inline void unix_insert_socket(struct hlist_head *list, struct sock *sk)
+static inline void unix_insert_unbound_socket(struct sock *sk)
 {
-	spin_lock(&unix_table_lock);
-	__unix_insert_socket(list, sk);
-	spin_unlock(&unix_table_lock);
+	unsigned int hash = unix_unbound_hash(sk);
+
+	spin_lock(&unix_table_locks[hash]);
+	__unix_insert_socket(hash, sk);
+	spin_unlock(&unix_table_locks[hash]);
 }
 
 static struct sock *__unix_find_socket_byname(struct net *net,
@@ -274,22 +337,22 @@ static inline struct sock *unix_find_socket_byname(struct net *net,
 {
 	struct sock *s;
 
-	spin_lock(&unix_table_lock);
+	spin_lock(&unix_table_locks[hash ^ type]);
 	s = __unix_find_socket_byname(net, sunname, len, type, hash);
 	if (s)
 		sock_hold(s);
-	spin_unlock(&unix_table_lock);
+	spin_unlock(&unix_table_locks[hash ^ type]);
 	return s;
 }
 
 static struct sock *unix_find_socket_byinode(struct inode *i)
 {
+	unsigned int hash = i->i_ino & (UNIX_HASH_SIZE - 1);
 	struct sock *s;
 	struct hlist_node *node;
 
-	spin_lock(&unix_table_lock);
-	sk_for_each(s, node,
-		    &unix_socket_table[i->i_ino & (UNIX_HASH_SIZE - 1)]) {
+	spin_lock(&unix_table_locks[hash]);
+	sk_for_each(s, node, &unix_socket_table[hash]) {
 		struct dentry *dentry = unix_sk(s)->dentry;
 
 		if (dentry && dentry->d_inode == i) {
@@ -299,7 +362,7 @@ static struct sock *unix_find_socket_byinode(struct inode *i)
 	}
 	s = NULL;
 found:
-	spin_unlock(&unix_table_lock);
+	spin_unlock(&unix_table_locks[hash]);
 	return s;
 }
 
@@ -630,7 +693,7 @@ static struct sock *unix_create1(struct net *net, struct socket *sock)
 	INIT_LIST_HEAD(&u->link);
 	mutex_init(&u->readlock); /* single task reading lock */
 	init_waitqueue_head(&u->peer_wait);
-	unix_insert_socket(unix_sockets_unbound, sk);
+	unix_insert_unbound_socket(sk);
 out:
 	if (sk == NULL)
 		atomic_long_dec(&unix_nr_socks);
@@ -693,6 +756,7 @@ static int unix_autobind(struct socket *sock)
 	struct unix_sock *u = unix_sk(sk);
 	static u32 ordernum = 1;
 	struct unix_address *addr;
+	unsigned int old_hash, new_hash;
 	int err;
 	unsigned int retries = 0;
 
@@ -713,13 +777,15 @@ static int unix_autobind(struct socket *sock)
 retry:
 	addr->len = sprintf(addr->name->sun_path+1, "%05x", ordernum) + 1 + sizeof(short);
 	addr->hash = unix_hash_fold(csum_partial(addr->name, addr->len, 0));
+	old_hash = sk->sk_hash;
+	new_hash = addr->hash ^ sk->sk_type;
 
-	spin_lock(&unix_table_lock);
+	unix_table_double_lock(old_hash, new_hash);
 	ordernum = (ordernum+1)&0xFFFFF;
 
 	if (__unix_find_socket_byname(net, addr->name, addr->len, sock->type,
 				      addr->hash)) {
-		spin_unlock(&unix_table_lock);
+		unix_table_double_unlock(old_hash, new_hash);
 		/*
 		 * __unix_find_socket_byname() may take long time if many names
 		 * are already in use.
@@ -737,8 +803,8 @@ retry:
 
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(&unix_socket_table[addr->hash], sk);
-	spin_unlock(&unix_table_lock);
+	__unix_insert_socket(new_hash, sk);
+	unix_table_double_unlock(old_hash, new_hash);
 	err = 0;
 
 out:	mutex_unlock(&u->readlock);
@@ -811,8 +877,8 @@ static int unix_bind(struct socket *sock, struct sockaddr *uaddr, int addr_len)
 	struct nameidata nd;
 	int err;
 	unsigned hash;
+	unsigned int old_hash, new_hash;
 	struct unix_address *addr;
-	struct hlist_head *list;
 
 	err = -EINVAL;
 	if (sunaddr->sun_family != AF_UNIX)
@@ -883,7 +949,13 @@ out_mknod_drop_write:
 		addr->hash = UNIX_HASH_SIZE;
 	}
 
-	spin_lock(&unix_table_lock);
+	old_hash = sk->sk_hash;
+	if (!sunaddr->sun_path[0])
+		new_hash = addr->hash;
+	else
+		new_hash = dentry->d_inode->i_ino & (UNIX_HASH_SIZE-1);
+
+	unix_table_double_lock(old_hash, new_hash);
 
 	if (!sunaddr->sun_path[0]) {
 		err = -EADDRINUSE;
@@ -892,10 +964,7 @@ out_mknod_drop_write:
 			unix_release_addr(addr);
 			goto out_unlock;
 		}
-
-		list = &unix_socket_table[addr->hash];
 	} else {
-		list = &unix_socket_table[dentry->d_inode->i_ino & (UNIX_HASH_SIZE-1)];
 		u->dentry = nd.path.dentry;
 		u->mnt    = nd.path.mnt;
 	}
@@ -903,10 +972,10 @@ out_mknod_drop_write:
 	err = 0;
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(list, sk);
+	__unix_insert_socket(new_hash, sk);
 
 out_unlock:
-	spin_unlock(&unix_table_lock);
+	unix_table_double_unlock(old_hash, new_hash);
 out_up:
 	mutex_unlock(&u->readlock);
 out:
@@ -1431,6 +1500,7 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (err < 0)
 			goto out;
 		namelen = err;
+		other = unix_peer_get_byname(sk, sunaddr, namelen);
 	} else {
 		sunaddr = NULL;
 		err = -ENOTCONN;
@@ -2170,76 +2240,95 @@ static unsigned int unix_dgram_poll(struct file *file, struct socket *sock,
 }
 
 #ifdef CONFIG_PROC_FS
-static struct sock *first_unix_socket(int *i)
+/*
+ * The position is encoded as the bucket in the high bits and the offset
+ * inside the bucket in the low ones, so that only the bucket being shown
+ * is locked and a later read() can pick up where the last one stopped.
+ */
+#define BUCKET_SPACE (BITS_PER_LONG - (UNIX_HASH_BITS + 1) - 1)
+
+#define get_bucket(x) ((x) >> BUCKET_SPACE)
+#define get_offset(x) ((x) & ((1L << BUCKET_SPACE) - 1))
+#define set_bucket_offset(b, o) ((b) << BUCKET_SPACE | (o))
+
+static struct sock *unix_from_bucket(struct seq_file *seq, loff_t *pos)
 {
-	for (*i = 0; *i <= UNIX_HASH_SIZE; (*i)++) {
-		if (!hlist_empty(&unix_socket_table[*i]))
-			return __sk_head(&unix_socket_table[*i]);
+	unsigned long offset = get_offset(*pos);
+	unsigned long bucket = get_bucket(*pos);
+	struct hlist_node *node;
+	struct sock *sk;
+	unsigned long count = 0;
+
+	sk_for_each(sk, node, &unix_socket_table[bucket]) {
+		if (sock_net(sk) != seq_file_net(seq))
+			continue;
+		if (++count == offset)
+			return sk;
 	}
+
 	return NULL;
 }
 
-static struct sock *next_unix_socket(int *i, struct sock *s)
+static struct sock *unix_get_first(struct seq_file *seq, loff_t *pos)
 {
-	struct sock *next = sk_next(s);
-	/* More in this chain? */
-	if (next)
-		return next;
-	/* Look for next non-empty chain. */
-	for ((*i)++; *i <= UNIX_HASH_SIZE; (*i)++) {
-		if (!hlist_empty(&unix_socket_table[*i]))
-			return __sk_head(&unix_socket_table[*i]);
+	unsigned long bucket = get_bucket(*pos);
+	struct sock *sk;
+
+	while (bucket < 2 * UNIX_HASH_SIZE) {
+		spin_lock(&unix_table_locks[bucket]);
+
+		sk = unix_from_bucket(seq, pos);
+		if (sk)
+			return sk;
+
+		spin_unlock(&unix_table_locks[bucket]);
+
+		*pos = set_bucket_offset(++bucket, 1);
 	}
+
 	return NULL;
 }
 
-struct unix_iter_state {
-	struct seq_net_private p;
-	int i;
-};
-
-static struct sock *unix_seq_idx(struct seq_file *seq, loff_t pos)
+static struct sock *unix_get_next(struct seq_file *seq, struct sock *sk,
+				  loff_t *pos)
 {
-	struct unix_iter_state *iter = seq->private;
-	loff_t off = 0;
-	struct sock *s;
+	unsigned long bucket = get_bucket(*pos);
 
-	for (s = first_unix_socket(&iter->i); s; s = next_unix_socket(&iter->i, s)) {
-		if (sock_net(s) != seq_file_net(seq))
-			continue;
-		if (off == pos)
-			return s;
-		++off;
-	}
-	return NULL;
+	for (sk = sk_next(sk); sk; sk = sk_next(sk))
+		if (sock_net(sk) == seq_file_net(seq))
+			return sk;
+
+	spin_unlock(&unix_table_locks[bucket]);
+
+	*pos = set_bucket_offset(++bucket, 1);
+
+	return unix_get_first(seq, pos);
 }
 
 static void *unix_seq_start(struct seq_file *seq, loff_t *pos)
-	__acquires(unix_table_lock)
 {
-	spin_lock(&unix_table_lock);
-	return *pos ? unix_seq_idx(seq, *pos - 1) : SEQ_START_TOKEN;
+	if (!*pos)
+		return SEQ_START_TOKEN;
+
+	return unix_get_first(seq, pos);
 }
 
 static void *unix_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 {
-	struct unix_iter_state *iter = seq->private;
-	struct sock *sk = v;
 	++*pos;
 
 	if (v == SEQ_START_TOKEN)
-		sk = first_unix_socket(&iter->i);
-	else
-		sk = next_unix_socket(&iter->i, sk);
-	while (sk && (sock_net(sk) != seq_file_net(seq)))
-		sk = next_unix_socket(&iter->i, sk);
-	return sk;
+		return unix_get_first(seq, pos);
+
+	return unix_get_next(seq, v, pos);
 }
 
 static void unix_seq_stop(struct seq_file *seq, void *v)
-	__releases(unix_table_lock)
 {
-	spin_unlock(&unix_table_lock);
+	struct sock *sk = v;
+
+	if (sk && sk != SEQ_START_TOKEN)
+		spin_unlock(&unix_table_locks[sk->sk_hash]);
 }
 
 static int unix_seq_show(struct seq_file *seq, void *v)
@@ -2296,7 +2385,7 @@ static const struct seq_operations unix_seq_ops = {
 static int unix_seq_open(struct inode *inode, struct file *file)
 {
 	return seq_open_net(inode, file, &unix_seq_ops,
-			    sizeof(struct unix_iter_state));
+			    sizeof(struct seq_net_private));
 }
 
 static const struct file_operations unix_seq_fops = {
@@ -2348,11 +2437,14 @@ static struct pernet_operations unix_net_ops = {
 
 static int __init af_unix_init(void)
 {
-	int rc = -1;
+	int rc = -1, i;
 	struct sk_buff *dummy_skb;
 
 	BUILD_BUG_ON(sizeof(struct unix_skb_parms) > sizeof(dummy_skb->cb));
 
+	for (i = 0; i < 2 * UNIX_HASH_SIZE; i++)
+		spin_lock_init(&unix_table_locks[i]);
+
 	rc = proto_register(&unix_proto, 1);
 	if (rc != 0) {
 		printk(KERN_CRIT "%s: Cannot create unix_sock SLAB cache!\n",
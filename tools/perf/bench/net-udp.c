@@ -0,0 +1,239 @@
+/*
+ *
+ * net-udp.c
+ *
+ * udp: Flood of datagrams over loopback UDP between two processes
+ *
+ * The sending socket is left unconnected by default, so that every packet
+ * goes through the destination and route lookup of sendto(); -c connects
+ * it for comparison, and -b sends in batches with sendmmsg().
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define LOOPS_DEFAULT 1000000
+static int loops = LOOPS_DEFAULT;
+static int size = 64;
+static int batch = 1;
+static bool use_connect = false;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of packets"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify payload size in bytes"),
+	OPT_INTEGER('b', "batch", &batch,
+		    "Send this many packets per sendmmsg() call"),
+	OPT_BOOLEAN('c', "connect", &use_connect,
+		    "connect() the sending socket"),
+	OPT_END()
+};
+
+static const char * const bench_net_udp_usage[] = {
+	"perf bench net udp <options>",
+	NULL
+};
+
+/* struct mmsghdr, which older C libraries do not have */
+struct bench_mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+/* Count packets until none came for a second: the rest were dropped */
+static void receiver(int fd, int report_fd)
+{
+	struct timeval tv = { 1, 0 };
+	char *buf = malloc(size);
+	int received = 0;
+
+	if (!buf)
+		barf("malloc()");
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		barf("setsockopt()");
+
+	while (received < loops) {
+		if (recv(fd, buf, size, 0) < 0)
+			break;
+		received++;
+	}
+
+	if (write(report_fd, &received, sizeof(received)) != sizeof(received))
+		barf("write()");
+	exit(0);
+}
+
+static void sender(int fd, struct sockaddr_in *addr)
+{
+	struct sockaddr *to = use_connect ? NULL : (struct sockaddr *)addr;
+	socklen_t tolen = use_connect ? 0 : sizeof(*addr);
+	struct bench_mmsghdr *msgs;
+	struct iovec iov;
+	char *buf;
+	int i, n;
+
+	buf = calloc(1, size);
+	if (!buf)
+		barf("calloc()");
+
+	if (batch <= 1) {
+		for (i = 0; i < loops; i++)
+			if (sendto(fd, buf, size, 0, to, tolen) < 0)
+				barf("sendto()");
+		free(buf);
+		return;
+	}
+
+#ifdef __NR_sendmmsg
+	msgs = calloc(batch, sizeof(*msgs));
+	if (!msgs)
+		barf("calloc()");
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	for (i = 0; i < batch; i++) {
+		msgs[i].msg_hdr.msg_name = to;
+		msgs[i].msg_hdr.msg_namelen = tolen;
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (i = 0; i < loops; i += n) {
+		n = syscall(__NR_sendmmsg, fd, msgs,
+			    loops - i < batch ? loops - i : batch, 0);
+		if (n < 0)
+			barf("sendmmsg()");
+	}
+	free(msgs);
+#else
+	fprintf(stderr, "sendmmsg() is not supported on this architecture\n");
+	exit(1);
+#endif
+	free(buf);
+}
+
+int bench_net_udp(int argc, const char **argv,
+		  const char *prefix __used)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	struct timeval start, stop, diff;
+	unsigned long long result_usec;
+	int rx_fd, tx_fd, report[2];
+	int received = 0, wait_stat;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_udp_usage, 0);
+
+	if (loops <= 0 || size <= 0) {
+		fprintf(stderr, "Invalid number of packets or size\n");
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/* Bound before the fork, so that no packet is sent too early */
+	rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (rx_fd < 0)
+		barf("socket()");
+	if (bind(rx_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(rx_fd, (struct sockaddr *)&addr, &len))
+		barf("bind()");
+
+	if (pipe(report))
+		barf("pipe()");
+
+	pid = fork();
+	if (pid < 0)
+		barf("fork()");
+	if (!pid) {
+		close(report[0]);
+		receiver(rx_fd, report[1]);
+	}
+	close(rx_fd);
+	close(report[1]);
+
+	tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (tx_fd < 0)
+		barf("socket()");
+	if (use_connect &&
+	    connect(tx_fd, (struct sockaddr *)&addr, sizeof(addr)))
+		barf("connect()");
+
+	gettimeofday(&start, NULL);
+	sender(tx_fd, &addr);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	if (read(report[0], &received, sizeof(received)) != sizeof(received))
+		received = -1;
+	if (waitpid(pid, &wait_stat, 0) != pid || !WIFEXITED(wait_stat))
+		received = -1;
+	close(tx_fd);
+
+	result_usec = diff.tv_sec * 1000000;
+	result_usec += diff.tv_usec;
+	if (!result_usec)
+		result_usec = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Sent %d %d-byte packets over loopback UDP, "
+		       "%s socket, %s\n\n", loops, size,
+		       use_connect ? "connected" : "unconnected",
+		       batch > 1 ? "sendmmsg()" : "sendto()");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/packet\n",
+		       (double)result_usec / (double)loops);
+		printf(" %14d packets/sec\n",
+		       (int)((double)loops /
+			     ((double)result_usec / (double)1000000)));
+		printf(" %14d packets received\n", received);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
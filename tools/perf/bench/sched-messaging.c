@@ -32,6 +32,7 @@
 #define DATASIZE 100
 
 static bool use_pipes = false;
+static bool use_dgram = false;
 static unsigned int loops = 100;
 static bool thread_mode = false;
 static unsigned int num_groups = 10;
@@ -62,7 +63,8 @@ static void fdpair(int fds[2])
 		if (pipe(fds) == 0)
 			return;
 	} else {
-		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0)
+		if (socketpair(AF_UNIX, use_dgram ? SOCK_DGRAM : SOCK_STREAM,
+			       0, fds) == 0)
 			return;
 	}
 
@@ -254,6 +256,8 @@ static unsigned int group(pthread_t *pth,
 static const struct option options[] = {
 	OPT_BOOLEAN('p', "pipe", &use_pipes,
 		    "Use pipe() instead of socketpair()"),
+	OPT_BOOLEAN('d', "dgram", &use_dgram,
+		    "Use SOCK_DGRAM socketpair()s instead of SOCK_STREAM"),
 	OPT_BOOLEAN('t', "thread", &thread_mode,
 		    "Be multi thread instead of multi process"),
 	OPT_UINTEGER('g', "group", &num_groups, "Specify number of groups"),
@@ -275,6 +279,7 @@ int bench_sched_messaging(int argc, const char **argv,
 	int readyfds[2], wakefds[2];
 	char dummy;
 	pthread_t *pth_tab;
+	double msecs;
 
 	argc = parse_options(argc, argv, options,
 			     bench_sched_message_usage, 0);
@@ -320,6 +325,11 @@ int bench_sched_messaging(int argc, const char **argv,
 		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
 		       diff.tv_sec,
 		       (unsigned long) (diff.tv_usec/1000));
+		msecs = diff.tv_sec * 1000.0 + diff.tv_usec / 1000.0;
+		if (msecs > 0)
+			printf(" %14lf messages/sec\n",
+			       (double)num_groups * num_fds * num_fds * loops *
+			       1000.0 / msecs);
 		break;
 	case BENCH_FORMAT_SIMPLE:
 		printf("%lu.%03lu\n", diff.tv_sec,